@@ -0,0 +1,226 @@
+/**
+* @file  qcodecompletion.cpp
+* @brief Source implementing a prefix-indexed completion engine.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodecompletion.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+
+namespace {
+
+struct Candidate
+{
+    int score;
+    int index;
+};
+
+// Scores key as a subsequence match of pattern, or returns -1. Consecutive
+// characters and characters that start a word part score higher.
+int fuzzyScore(const QString &key, const QString &pattern)
+{
+    int score = 0;
+    int streak = 0;
+    int k = 0;
+    for (int p = 0; p < pattern.length(); ++p) {
+        const QChar c = pattern.at(p);
+        int gap = 0;
+        while (k < key.length() && key.at(k) != c) {
+            ++k;
+            ++gap;
+        }
+        if (k == key.length())
+            return -1;
+
+        streak = gap ? 1 : streak + 1;
+        score += streak * 4;
+        if (k == 0 || key.at(k - 1) == QLatin1Char('_'))
+            score += 6;
+        score -= qMin(gap, 4);
+        ++k;
+    }
+    return score - (key.length() - pattern.length()) / 4;
+}
+
+} // namespace
+
+QCodeCompletionEngine::QCodeCompletionEngine(QObject *parent)
+    : QObject(parent), builtinIndex(new Index), documentIndex(new Index), indexStale(false), resultLimit(50)
+{
+    watcher = new QFutureWatcher<QStringList>(this);
+    connect(watcher, SIGNAL(finished()), this, SLOT(queryFinished()));
+
+    indexWatcher = new QFutureWatcher<IndexPointer>(this);
+    connect(indexWatcher, SIGNAL(finished()), this, SLOT(indexFinished()));
+}
+
+void QCodeCompletionEngine::setWords(const QStringList &words)
+{
+    builtinIndex = buildIndex(words, IndexPointer(new Index));
+    if (!documentWords.isEmpty())
+        setDocumentWords(documentWords);
+}
+
+void QCodeCompletionEngine::setDocumentWords(const QStringList &words)
+{
+    documentWords = words;
+    if (indexWatcher->isRunning())
+        indexStale = true;
+    else
+        startIndexBuild();
+}
+
+void QCodeCompletionEngine::startIndexBuild()
+{
+    indexStale = false;
+    indexWatcher->setFuture(QtConcurrent::run(&QCodeCompletionEngine::buildIndex, documentWords, builtinIndex));
+}
+
+void QCodeCompletionEngine::indexFinished()
+{
+    // Words that changed meanwhile need another build.
+    if (indexStale) {
+        startIndexBuild();
+        return;
+    }
+    documentIndex = indexWatcher->result();
+    emit documentWordsIndexed();
+}
+
+QCodeCompletionEngine::IndexPointer QCodeCompletionEngine::buildIndex(const QStringList &words, IndexPointer exclude)
+{
+    QVector<QPair<QString, QString> > entries;
+    entries.reserve(words.size());
+    foreach (const QString &word, words) {
+        if (!word.isEmpty())
+            entries.append(qMakePair(word.toLower(), word));
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    Index *built = new Index;
+    built->keys.reserve(entries.size());
+    built->words.reserve(entries.size());
+    for (int i = 0; i < entries.size(); ++i) {
+        // Words already in the excluded index would be offered twice.
+        const QString &key = entries.at(i).first;
+        QVector<QString>::const_iterator it =
+                std::lower_bound(exclude->keys.constBegin(), exclude->keys.constEnd(), key);
+        bool duplicate = false;
+        for (; it != exclude->keys.constEnd() && *it == key && !duplicate; ++it)
+            duplicate = exclude->words.at(int(it - exclude->keys.constBegin())) == entries.at(i).second;
+        if (duplicate)
+            continue;
+        built->keys.append(key);
+        built->words.append(entries.at(i).second);
+    }
+    return IndexPointer(built);
+}
+
+void QCodeCompletionEngine::complete(const QString &prefix)
+{
+    latestPrefix = prefix;
+    if (!watcher->isRunning())
+        startQuery(prefix);
+}
+
+void QCodeCompletionEngine::startQuery(const QString &prefix)
+{
+    runningPrefix = prefix;
+    watcher->setFuture(QtConcurrent::run(&QCodeCompletionEngine::query, builtinIndex, documentIndex,
+                                         prefix, resultLimit));
+}
+
+void QCodeCompletionEngine::queryFinished()
+{
+    // Keystrokes that arrived meanwhile supersede this result.
+    if (runningPrefix != latestPrefix) {
+        startQuery(latestPrefix);
+        return;
+    }
+    emit completionsReady(runningPrefix, watcher->result());
+}
+
+QStringList QCodeCompletionEngine::query(IndexPointer builtin, IndexPointer document,
+                                         const QString &prefix, int limit)
+{
+    QStringList results;
+    const QString pattern = prefix.toLower();
+    const Index *indexes[] = { builtin.data(), document.data() };
+
+    // Prefix hits of both indexes, merged in key order.
+    QVector<QString>::const_iterator it[2];
+    for (int n = 0; n < 2; ++n)
+        it[n] = std::lower_bound(indexes[n]->keys.constBegin(), indexes[n]->keys.constEnd(), pattern);
+    while (results.size() < limit) {
+        int next = -1;
+        for (int n = 0; n < 2; ++n) {
+            if (it[n] == indexes[n]->keys.constEnd() || !it[n]->startsWith(pattern))
+                continue;
+            if (next < 0 || *it[n] < *it[next])
+                next = n;
+        }
+        if (next < 0)
+            break;
+        results.append(indexes[next]->words.at(int(it[next] - indexes[next]->keys.constBegin())));
+        ++it[next];
+    }
+
+    if (results.size() >= limit || pattern.isEmpty())
+        return results;
+
+    // Fuzzy candidates have to share the first character, which is one
+    // contiguous range of the sorted keys; scanning every key made each
+    // keystroke linear in the vocabulary. Candidate indexes count on from
+    // the built-in words into the document words.
+    QVector<Candidate> candidates;
+    const int builtinCount = builtin->keys.size();
+    const QString first = pattern.left(1);
+    const QString afterFirst = QString(QChar(first.at(0).unicode() + 1));
+    for (int n = 0; n < 2; ++n) {
+        const QVector<QString> &keys = indexes[n]->keys;
+        const int begin = int(std::lower_bound(keys.constBegin(), keys.constEnd(), first) - keys.constBegin());
+        const int end = int(std::lower_bound(keys.constBegin(), keys.constEnd(), afterFirst) - keys.constBegin());
+        for (int i = begin; i < end; ++i) {
+            if (keys.at(i).startsWith(pattern))
+                continue;
+            const int score = fuzzyScore(keys.at(i), pattern);
+            if (score >= 0) {
+                Candidate candidate = { score, n ? builtinCount + i : i };
+                candidates.append(candidate);
+            }
+        }
+    }
+
+    const int wanted = qMin(limit - results.size(), candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + wanted, candidates.end(),
+                      [](const Candidate &a, const Candidate &b) {
+                          return a.score != b.score ? a.score > b.score : a.index < b.index;
+                      });
+    for (int i = 0; i < wanted; ++i) {
+        const int index = candidates.at(i).index;
+        results.append(index < builtinCount ? builtin->words.at(index)
+                                            : document->words.at(index - builtinCount));
+    }
+    return results;
+}
@@ -0,0 +1,95 @@
+/**
+* @file  qcodecompletion.h
+* @brief Header implementing a prefix-indexed completion engine.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODECOMPLETION_H
+#define QCODECOMPLETION_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+// Keeps the candidate words sorted by their lower-case form, so all words
+// starting with a prefix are found with a binary search. When there are
+// fewer prefix hits than requested the rest is filled with fuzzy
+// (subsequence) matches among the words with the same first character,
+// so a query only touches a slice of the index. Queries run on the
+// thread pool against immutable snapshots of the index and only the
+// latest one is reported.
+//
+// The built-in words are sorted once. Document words change while typing,
+// so their index is rebuilt on the thread pool and queries are merged
+// from both.
+class QCodeCompletionEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    QCodeCompletionEngine(QObject *parent = 0);
+
+    // Built-in words are sorted into their own index right away; document
+    // identifiers get a second one, rebuilt on the thread pool, that leaves
+    // out words already built in.
+    void setWords(const QStringList &words);
+    void setDocumentWords(const QStringList &words);
+
+    int maximumResults() const { return resultLimit; }
+    void setMaximumResults(int limit) { resultLimit = limit; }
+
+    // Asynchronous; answered through completionsReady().
+    void complete(const QString &prefix);
+
+signals:
+    void completionsReady(const QString &prefix, const QStringList &completions);
+    void documentWordsIndexed();
+
+private slots:
+    void queryFinished();
+    void indexFinished();
+
+private:
+    struct Index
+    {
+        QVector<QString> keys;      // lower case, sorted
+        QVector<QString> words;     // same order as keys
+    };
+    typedef QSharedPointer<const Index> IndexPointer;
+
+    static IndexPointer buildIndex(const QStringList &words, IndexPointer exclude);
+    static QStringList query(IndexPointer builtin, IndexPointer document, const QString &prefix, int limit);
+    void startQuery(const QString &prefix);
+    void startIndexBuild();
+
+    QStringList documentWords;
+    IndexPointer builtinIndex;
+    IndexPointer documentIndex;
+    QFutureWatcher<IndexPointer> *indexWatcher;
+    bool indexStale;
+    QFutureWatcher<QStringList> *watcher;
+    QString runningPrefix;
+    QString latestPrefix;
+    int resultLimit;
+};
+
+#endif // QCODECOMPLETION_H
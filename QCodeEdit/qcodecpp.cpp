@@ -22,104 +22,375 @@
 **/
 
 #include "qcodecpp.h"
+#include "qcodeprofiler.h"
+
+#include <QElapsedTimer>
+#include <QTextDocument>
+#include <QThread>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <climits>
+
+namespace {
+
+// Blocks handed to one worker job, and the time slice spent applying results per event loop pass.
+const int JobSize = 512;
+const int ApplyBudgetMs = 8;
+
+// Results waiting to be applied before no more jobs are dispatched. Each
+// holds a cursor the document adjusts on every edit, so this keeps edits
+// cheap while a large document is highlighted.
+const int MaxReadyItems = 4 * JobSize;
+
+// Blocks above and below the viewport that lazy mode formats ahead of scrolling.
+const int LazyMargin = 100;
+
+// Formats per token kind. They never change, so every highlighter shares one table.
+struct FormatTable
+{
+    FormatTable()
+    {
+        formats[QCodeLexer::Keyword].setForeground(Qt::darkBlue);
+        formats[QCodeLexer::Keyword].setFontWeight(QFont::Bold);
+
+        formats[QCodeLexer::Number].setFontWeight(QFont::Bold);
+        formats[QCodeLexer::Number].setForeground(Qt::darkMagenta);
+
+        formats[QCodeLexer::Function].setForeground(Qt::blue);
+        formats[QCodeLexer::InfixOperator].setForeground(Qt::red);
+        formats[QCodeLexer::DynamicFunction].setForeground(Qt::darkRed);
+        formats[QCodeLexer::String].setForeground(Qt::darkBlue);
+        formats[QCodeLexer::Comment].setForeground(Qt::darkGreen);
+        formats[QCodeLexer::MultiLineComment].setForeground(Qt::darkCyan);
+    }
+
+    QTextCharFormat formats[QCodeLexer::TokenKindCount];
+};
+
+const FormatTable &formatTable()
+{
+    static const FormatTable table;
+    return table;
+}
+
+QHash<const QTextDocument *, int> &formattingDepth()
+{
+    static QHash<const QTextDocument *, int> depth;
+    return depth;
+}
+
+// Marks the document as being formatted while in scope.
+class FormattingScope
+{
+public:
+    explicit FormattingScope(const QTextDocument *document) : document(document)
+    {
+        ++formattingDepth()[document];
+    }
+
+    ~FormattingScope()
+    {
+        if (--formattingDepth()[document] == 0)
+            formattingDepth().remove(document);
+    }
+
+private:
+    const QTextDocument *document;
+};
+
+} // namespace
 
 QCodeCPP::QCodeCPP(QTextDocument *parent)
-    : QSyntaxHighlighter(parent)
-{
-    HighlightingRule rule;
-
-    keywordFormat.setForeground(Qt::darkBlue);
-    keywordFormat.setFontWeight(QFont::Bold);
-    QStringList keywordPatterns;
-#define KEYWORD(KW) (keywordPatterns << "\\b" #KW "\\b")
-    KEYWORD(if);
-    KEYWORD(else);
-    KEYWORD(for);
-    KEYWORD(while);
-    KEYWORD(do);
-    KEYWORD(break);
-    KEYWORD(continue);
-    KEYWORD(return);
-    KEYWORD(int);
-    KEYWORD(double);
-    KEYWORD(bool);
-    KEYWORD(void);
-    KEYWORD(string);
-    KEYWORD(infix);
-    KEYWORD(true);
-    KEYWORD(false);
-#undef KEYWORD
-    foreach (const QString &pattern, keywordPatterns) {
-        rule.pattern = QRegExp(pattern);
-        rule.format = keywordFormat;
-        highlightingRules.append(rule);
+    : QSyntaxHighlighter(parent),
+      highlightMode(Synchronous),
+      generation(0),
+      editCount(0),
+      firstPendingHint(INT_MAX),
+      pendingCount(0),
+      firstVisible(0),
+      lastVisible(0)
+{
+    dispatchTimer = new QTimer(this);
+    dispatchTimer->setSingleShot(true);
+    dispatchTimer->setInterval(0);
+    connect(dispatchTimer, SIGNAL(timeout()), this, SLOT(dispatchJobs()));
+
+    applyTimer = new QTimer(this);
+    applyTimer->setSingleShot(true);
+    applyTimer->setInterval(0);
+    connect(applyTimer, SIGNAL(timeout()), this, SLOT(applyResults()));
+
+    // Format now instead of from the base class's queued call, which
+    // would be reported as an edit.
+    if (parent) {
+        connect(parent, SIGNAL(contentsChange(int,int,int)), this, SLOT(countEdit()));
+        FormattingScope scope(parent);
+        rehighlight();
     }
+}
 
-    numericConstantFormat.setFontWeight(QFont::Bold);
-    numericConstantFormat.setForeground(Qt::darkMagenta);
-    rule.pattern = QRegExp("\\b-?[0-9]+.[0-9]*|-?[0-9]+\\b");
-    rule.format = numericConstantFormat;
-    highlightingRules.append(rule);
-
-    functionFormat.setForeground(Qt::blue);
-    rule.pattern = QRegExp("\\b[A-Za-z0-9_]+(?=\\()");
-    rule.format = functionFormat;
-    highlightingRules.append(rule);
-
-    infixOperatorFormat.setForeground(Qt::red);
-    rule.pattern = QRegExp("\\b[\\\\=\\^\\$\\?\\|\\*\\+-/<>@]+\\b");
-    rule.format = infixOperatorFormat;
-    highlightingRules.append(rule);
-
-    dynamicFunctionFormat.setForeground(Qt::darkRed);
-    rule.pattern = QRegExp("\\b[A-Za-z0-9_]+!(?=\\()");
-    rule.format = dynamicFunctionFormat;
-    highlightingRules.append(rule);
-
-    quotationFormat.setForeground(Qt::darkBlue);
-    rule.pattern = QRegExp("\".*\"");
-    rule.format = quotationFormat;
-    highlightingRules.append(rule);
-
-    singleLineCommentFormat.setForeground(Qt::darkGreen);
-    rule.pattern = QRegExp("//[^\n]*");
-    rule.format = singleLineCommentFormat;
-    highlightingRules.append(rule);
-
-    multiLineCommentFormat.setForeground(Qt::darkCyan);
-
-    commentStartExpression = QRegExp("/\\*");
-    commentEndExpression = QRegExp("\\*/");
+bool QCodeCPP::isFormatting(const QTextDocument *document)
+{
+    return formattingDepth().contains(document);
+}
+
+void QCodeCPP::countEdit()
+{
+    if (!isFormatting(document()))
+        ++editCount;
 }
 
 void QCodeCPP::highlightBlock(const QString &text)
 {
-    foreach (const HighlightingRule &rule, highlightingRules) {
-        QRegExp expression(rule.pattern);
-        int index = expression.indexIn(text);
-        while (index >= 0) {
-            int length = expression.matchedLength();
-            setFormat(index, length, rule.format);
-            index = expression.indexIn(text, index + length);
+    QCODE_PROBE("highlightBlock");
+    const int state = previousBlockState() == QCodeLexer::InComment
+            ? QCodeLexer::InComment : QCodeLexer::Normal;
+    const quint64 hash = QCodeLexer::hashText(text);
+
+    QCodeBlockData *data = static_cast<QCodeBlockData *>(currentBlockUserData());
+    if (!data) {
+        data = new QCodeBlockData;
+        setCurrentBlockUserData(data);
+    }
+
+    const bool stateValid = data->isValidFor(text, hash, state);
+    if (!stateValid || !data->formatted) {
+        if (highlightMode == Background) {
+            // Keep the old formats and state until the worker result lands,
+            // so nothing cascades into the following blocks meanwhile.
+            markPending(data);
+            applyTokens(data->tokens);
+            setCurrentBlockState(currentBlockState());
+            return;
+        }
+        if (highlightMode == Lazy && !isNearViewport(currentBlock().blockNumber())) {
+            // Off-screen blocks only carry the comment state forward; they
+            // are formatted by setVisibleBlocks once scrolled into view.
+            if (!stateValid) {
+                data->exitState = QCodeLexer::scanState(text, state);
+                data->textHash = hash;
+                data->textLength = text.length();
+                data->entryState = state;
+                data->formatted = false;
+            }
+            setCurrentBlockState(data->exitState);
+            return;
         }
+        data->exitState = QCodeLexer::tokenize(text, state, &data->tokens);
+        data->textHash = hash;
+        data->textLength = text.length();
+        data->entryState = state;
+        data->formatted = true;
+    }
+
+    if (data->pending) {
+        data->pending = false;
+        --pendingCount;
     }
-    setCurrentBlockState(0);
-
-    int startIndex = 0;
-    if (previousBlockState() != 1)
-        startIndex = commentStartExpression.indexIn(text);
-
-    while (startIndex >= 0) {
-        int endIndex = commentEndExpression.indexIn(text, startIndex);
-        int commentLength;
-        if (endIndex == -1) {
-            setCurrentBlockState(1);
-            commentLength = text.length() - startIndex;
-        } else {
-            commentLength = endIndex - startIndex
-                            + commentEndExpression.matchedLength();
+    applyTokens(data->tokens);
+    setCurrentBlockState(data->exitState);
+}
+
+void QCodeCPP::setMode(Mode mode)
+{
+    if (mode == highlightMode)
+        return;
+    highlightMode = mode;
+
+    // Results of jobs still running belong to the previous mode.
+    ++generation;
+    readyItems.clear();
+    readyCursors.clear();
+    FormattingScope scope(document());
+    rehighlight();
+}
+
+void QCodeCPP::setVisibleBlocks(int first, int last)
+{
+    firstVisible = first;
+    lastVisible = last;
+    if (highlightMode != Lazy || !document())
+        return;
+
+    FormattingScope scope(document());
+    int number = qMax(0, first - LazyMargin);
+    QTextBlock block = document()->findBlockByNumber(number);
+    while (block.isValid() && number <= last + LazyMargin) {
+        QCodeBlockData *data = static_cast<QCodeBlockData *>(block.userData());
+        if (!data || !data->formatted)
+            rehighlightBlock(block);
+        block = block.next();
+        ++number;
+    }
+}
+
+bool QCodeCPP::isNearViewport(int blockNumber) const
+{
+    return blockNumber >= firstVisible - LazyMargin && blockNumber <= lastVisible + LazyMargin;
+}
+
+void QCodeCPP::markPending(QCodeBlockData *data)
+{
+    if (!data->pending) {
+        data->pending = true;
+        ++pendingCount;
+    }
+    firstPendingHint = qMin(firstPendingHint, currentBlock().blockNumber());
+    dispatchTimer->start();
+}
+
+void QCodeCPP::dispatchJobs()
+{
+    if (highlightMode != Background || !document())
+        return;
+    // applyResults() dispatches again once it has caught up.
+    if (readyItems.size() >= MaxReadyItems)
+        return;
+
+    const int maxJobs = qMax(1, QThread::idealThreadCount());
+    QTextBlock block = document()->findBlockByNumber(firstPendingHint == INT_MAX ? 0 : firstPendingHint);
+
+    while (runningJobs.size() < maxJobs && pendingCount > 0 && block.isValid()) {
+        Job job;
+        job.generation = generation;
+        QVector<QTextCursor> cursors;
+        QTextBlock previous;
+
+        while (block.isValid() && job.items.size() < JobSize) {
+            QCodeBlockData *data = static_cast<QCodeBlockData *>(block.userData());
+            if (data && data->pending) {
+                data->pending = false;
+                --pendingCount;
+
+                JobItem item;
+                item.data = data;
+                item.editCount = editCount;
+                item.text = block.text();
+                if (previous.isValid() && previous.next() == block)
+                    item.entryState = -1;
+                else
+                    item.entryState = block.previous().userState() == QCodeLexer::InComment
+                            ? QCodeLexer::InComment : QCodeLexer::Normal;
+                job.items.append(item);
+                previous = block;
+
+                // Edits above the block while the job runs shift its number;
+                // the cursor follows it to wherever it ends up.
+                QTextCursor cursor(block);
+                cursor.setKeepPositionOnInsert(true);
+                cursors.append(cursor);
+            }
+            block = block.next();
         }
-        setFormat(startIndex, commentLength, multiLineCommentFormat);
-        startIndex = commentStartExpression.indexIn(text, startIndex + commentLength);
+
+        if (job.items.isEmpty())
+            break;
+
+        QFutureWatcher<Job> *watcher = new QFutureWatcher<Job>(this);
+        connect(watcher, SIGNAL(finished()), this, SLOT(jobFinished()));
+        runningJobs.append(watcher);
+        jobCursors.insert(watcher, cursors);
+        watcher->setFuture(QtConcurrent::run(&QCodeCPP::runJob, job));
+    }
+
+    if (!block.isValid()) {
+        // Scanned to the end, anything not found was deleted with its block.
+        firstPendingHint = INT_MAX;
+        pendingCount = 0;
+    } else {
+        firstPendingHint = block.blockNumber();
+    }
+}
+
+QCodeCPP::Job QCodeCPP::runJob(Job job)
+{
+    int state = QCodeLexer::Normal;
+    for (int i = 0; i < job.items.size(); ++i) {
+        JobItem &item = job.items[i];
+        if (item.entryState < 0)
+            item.entryState = state;
+        item.textHash = QCodeLexer::hashText(item.text);
+        item.exitState = QCodeLexer::tokenize(item.text, item.entryState, &item.tokens);
+        state = item.exitState;
+    }
+    return job;
+}
+
+void QCodeCPP::jobFinished()
+{
+    QFutureWatcher<Job> *watcher = static_cast<QFutureWatcher<Job> *>(sender());
+    runningJobs.removeOne(watcher);
+    const QVector<QTextCursor> cursors = jobCursors.take(watcher);
+    watcher->deleteLater();
+
+    const Job job = watcher->result();
+    if (job.generation == generation) {
+        readyItems += job.items;
+        readyCursors += cursors;
+        applyTimer->start();
+    }
+    if (pendingCount > 0)
+        dispatchTimer->start();
+}
+
+void QCodeCPP::applyResults()
+{
+    if (!document())
+        return;
+
+    FormattingScope scope(document());
+    QElapsedTimer timer;
+    timer.start();
+
+    int applied = 0;
+    while (applied < readyItems.size() && (applied == 0 || timer.elapsed() < ApplyBudgetMs)) {
+        const JobItem &item = readyItems.at(applied);
+        QTextBlock block = readyCursors.at(applied).block();
+        ++applied;
+        if (!block.isValid())
+            continue;
+
+        // Unless the document is unedited since the snapshot, make sure the
+        // cursor still sits on the same block with the same text and entry
+        // state. Anything else goes back through highlightBlock, which
+        // queues it again if its cached tokens are stale.
+        QCodeBlockData *data = static_cast<QCodeBlockData *>(block.userData());
+        if (data != item.data)
+            data = 0;
+        if (data && item.editCount != editCount) {
+            const int entryState = block.previous().userState() == QCodeLexer::InComment
+                    ? QCodeLexer::InComment : QCodeLexer::Normal;
+            if (item.entryState != entryState || block.text() != item.text)
+                data = 0;
+        }
+        if (!data) {
+            rehighlightBlock(block);
+            continue;
+        }
+
+        data->tokens = item.tokens;
+        data->textHash = item.textHash;
+        data->textLength = item.text.length();
+        data->entryState = item.entryState;
+        data->exitState = item.exitState;
+        data->formatted = true;
+        rehighlightBlock(block);
+    }
+
+    readyItems.remove(0, applied);
+    readyCursors.remove(0, applied);
+    if (!readyItems.isEmpty())
+        applyTimer->start();
+    if (pendingCount > 0 && readyItems.size() < MaxReadyItems)
+        dispatchTimer->start();
+}
+
+void QCodeCPP::applyTokens(const QCodeLexer::TokenList &tokens)
+{
+    const QTextCharFormat *formats = formatTable().formats;
+    foreach (const QCodeLexer::Token &token, tokens) {
+        if (token.kind != QCodeLexer::Identifier)
+            setFormat(token.start, token.length, formats[token.kind]);
     }
 }
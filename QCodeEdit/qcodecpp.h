@@ -27,9 +27,16 @@
 
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QTextCursor>
+
+#include "qcodelexer.h"
 
 QT_BEGIN_NAMESPACE
 class QTextDocument;
+class QTimer;
 QT_END_NAMESPACE
 
 class QCodeCPP : public QSyntaxHighlighter
@@ -37,31 +44,69 @@ class QCodeCPP : public QSyntaxHighlighter
     Q_OBJECT
 
 public:
+    enum Mode {
+        Synchronous,    // every block is tokenized inside highlightBlock
+        Background,     // tokenizing runs on the thread pool, results are applied in batches
+        Lazy            // only blocks near the viewport are formatted, the rest track states
+    };
+
     QCodeCPP(QTextDocument *parent = 0);
 
+    Mode mode() const { return highlightMode; }
+    void setMode(Mode mode);
+
+    // True while a highlighter applies formats to the document. Those
+    // arrive as contentsChange() too, but they are not edits.
+    static bool isFormatting(const QTextDocument *document);
+
+public slots:
+    void setVisibleBlocks(int first, int last);
+
 protected:
     void highlightBlock(const QString &text);
 
+private slots:
+    void countEdit();
+    void dispatchJobs();
+    void jobFinished();
+    void applyResults();
+
 private:
-    struct HighlightingRule
+    struct JobItem
+    {
+        QCodeBlockData *data;   // identity only, never dereferenced by the worker
+        int editCount;          // edits to the document when the snapshot was taken
+        QString text;
+        int entryState;     // -1 continues from the exit state of the previous item
+        quint64 textHash;
+        int exitState;
+        QCodeLexer::TokenList tokens;
+    };
+
+    struct Job
     {
-        QRegExp pattern;
-        QTextCharFormat format;
+        int generation;
+        QVector<JobItem> items;
     };
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegExp commentStartExpression;
-    QRegExp commentEndExpression;
-
-    QTextCharFormat keywordFormat;
-    //QTextCharFormat classFormat;
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat quotationFormat;
-    QTextCharFormat functionFormat;
-    QTextCharFormat dynamicFunctionFormat;
-    QTextCharFormat infixOperatorFormat;
-    QTextCharFormat numericConstantFormat;
+
+    static Job runJob(Job job);
+    void markPending(QCodeBlockData *data);
+    bool isNearViewport(int blockNumber) const;
+    void applyTokens(const QCodeLexer::TokenList &tokens);
+
+    Mode highlightMode;
+    int generation;
+    int editCount;
+    int firstPendingHint;
+    int pendingCount;
+    int firstVisible;
+    int lastVisible;
+    QList<QFutureWatcher<Job> *> runningJobs;
+    QHash<QFutureWatcher<Job> *, QVector<QTextCursor> > jobCursors;
+    QVector<JobItem> readyItems;
+    QVector<QTextCursor> readyCursors;  // follow each ready item's block through edits
+    QTimer *dispatchTimer;
+    QTimer *applyTimer;
 };
 
 #endif // HIGHLIGHTER_H
@@ -24,8 +24,34 @@
 #include <QtWidgets>
 
 #include "qcodeedit.h"
+#include "qcodecompletion.h"
+#include "qcodecpp.h"
+#include "qcodeprofiler.h"
+#include "qcodesymbolindex.h"
+#include "qcodeundo.h"
 
-QCodeEdit::QCodeEdit(QWidget *parent) : QPlainTextEdit(parent)
+#include <algorithm>
+
+namespace {
+
+// Past this many rectangles a single viewport update is cheaper.
+const int MaxDirtyRects = 256;
+
+bool rangeBefore(const QCodeEdit::LayerRange &range, int position)
+{
+    return range.position < position;
+}
+
+bool rangeLess(const QCodeEdit::LayerRange &a, const QCodeEdit::LayerRange &b)
+{
+    return a.position < b.position;
+}
+
+} // namespace
+
+QCodeEdit::QCodeEdit(QWidget *parent) : QPlainTextEdit(parent),
+    codeCompleter(0), completionSpan(0), firstVisibleBlockNumber(-1), lastVisibleBlockNumber(-1),
+    digitWidth(0), lineHeight(0), gutterWidth(-1), paintedBlockCount(-1)
 {
     currentLineBackground = QColor(180,220,250);
     marginBackground = Qt::lightGray;
@@ -34,17 +60,34 @@ QCodeEdit::QCodeEdit(QWidget *parent) : QPlainTextEdit(parent)
     this->setLineWrapMode(QPlainTextEdit::NoWrap);
 
     lineNumberArea = new LineNumberArea(this);
+    updateDigitAtlas();
 
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineNumberAreaWidth(int)));
     connect(this, SIGNAL(updateRequest(QRect,int)), this, SLOT(updateLineNumberArea(QRect,int)));
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(highlightCurrentLine()));
+    connect(document(), SIGNAL(contentsChange(int,int,int)), this, SLOT(shiftLayerRanges(int,int,int)));
 
     updateLineNumberAreaWidth(0);
     highlightCurrentLine();
 
+    undoHistory = new QCodeUndoStack(document(), this);
+
+    completionModel = new QStringListModel(this);
+    completionEngine = new QCodeCompletionEngine(this);
+    static const QStringList builtinWords = wordsFromFile(":/wordlist.txt");
+    completionEngine->setWords(builtinWords);
+    connect(completionEngine, SIGNAL(completionsReady(QString,QStringList)),
+            this, SLOT(showCompletions(QString,QStringList)));
+
+    // Identifiers typed into the document join the built-in words once typing pauses.
+    symbolIndex = new QCodeSymbolIndex(document());
+    symbolRefreshTimer = new QTimer(this);
+    symbolRefreshTimer->setSingleShot(true);
+    symbolRefreshTimer->setInterval(300);
+    connect(symbolIndex, SIGNAL(symbolsChanged()), symbolRefreshTimer, SLOT(start()));
+    connect(symbolRefreshTimer, SIGNAL(timeout()), this, SLOT(refreshDocumentWords()));
+
     codeCompleter = new QCompleter(this);
-    codeCompleter->setModel(modelFromFile(":/wordlist.txt"));
-    codeCompleter->setModelSorting(QCompleter::CaseInsensitivelySortedModel);
     codeCompleter->setCaseSensitivity(Qt::CaseInsensitive);
     codeCompleter->setWrapAround(false);
     this->setCompleter(codeCompleter);
@@ -60,22 +103,21 @@ void QCodeEdit::setCompleter(QCompleter *completer)
     if (!codeCompleter)
         return;
 
+    // The engine does the filtering; the popup only lists its top results.
+    codeCompleter->setModel(completionModel);
     codeCompleter->setWidget(this);
-    codeCompleter->setCompletionMode(QCompleter::PopupCompletion);
+    codeCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
     codeCompleter->setCaseSensitivity(Qt::CaseInsensitive);
     QObject::connect(codeCompleter, SIGNAL(activated(QString)),
                      this, SLOT(insertCompletion(QString)));
 }
 
-QAbstractItemModel *QCodeEdit::modelFromFile(const QString& fileName)
+QStringList QCodeEdit::wordsFromFile(const QString& fileName)
 {
     QFile file(fileName);
     if (!file.open(QFile::ReadOnly))
-        return new QStringListModel(codeCompleter);
+        return QStringList();
 
-#ifndef QT_NO_CURSOR
-    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-#endif
     QStringList words;
 
     while (!file.atEnd()) {
@@ -84,10 +126,7 @@ QAbstractItemModel *QCodeEdit::modelFromFile(const QString& fileName)
             words << line.trimmed();
     }
 
-#ifndef QT_NO_CURSOR
-    QApplication::restoreOverrideCursor();
-#endif
-    return new QStringListModel(words, codeCompleter);
+    return words;
 }
 
 QString QCodeEdit::textUnderCursor() const
@@ -101,12 +140,44 @@ void QCodeEdit::insertCompletion(const QString& completion)
 {
     if (codeCompleter->widget() != this)
         return;
+    // Fuzzy matches need not start with the typed prefix, so the whole
+    // word is replaced rather than completed.
     QTextCursor tc = textCursor();
-    int extra = completion.length() - codeCompleter->completionPrefix().length();
-    tc.movePosition(QTextCursor::Left);
-    tc.movePosition(QTextCursor::EndOfWord);
-    tc.insertText(completion.right(extra));
+    tc.select(QTextCursor::WordUnderCursor);
+    undoHistory->beginCapture(tc.selectionStart(), tc.selectionEnd());
+    tc.insertText(completion);
+    undoHistory->endCapture();
     setTextCursor(tc);
+    pendingCompletionPrefix.clear();
+}
+
+void QCodeEdit::refreshDocumentWords()
+{
+    completionEngine->setDocumentWords(symbolIndex->symbols());
+}
+
+void QCodeEdit::showCompletions(const QString &prefix, const QStringList &completions)
+{
+    QCODE_PROBE_END(completionSpan);
+    if (!codeCompleter || prefix != pendingCompletionPrefix || prefix != textUnderCursor())
+        return;
+
+    // The word being typed is itself in the symbol index.
+    QStringList shown = completions;
+    shown.removeAll(prefix);
+    if (shown.isEmpty()) {
+        codeCompleter->popup()->hide();
+        return;
+    }
+
+    completionModel->setStringList(shown);
+    codeCompleter->setCompletionPrefix(prefix);
+    codeCompleter->popup()->setCurrentIndex(codeCompleter->completionModel()->index(0, 0));
+
+    QRect cr = cursorRect();
+    cr.setWidth(codeCompleter->popup()->sizeHintForColumn(0)
+                + codeCompleter->popup()->verticalScrollBar()->sizeHint().width());
+    codeCompleter->complete(cr); // popup it up!
 }
 
 void QCodeEdit::focusInEvent(QFocusEvent *e)
@@ -118,6 +189,17 @@ void QCodeEdit::focusInEvent(QFocusEvent *e)
 
 void QCodeEdit::keyPressEvent(QKeyEvent *e)
 {
+    QCODE_PROBE("keyPressEvent");
+    if (e == QKeySequence::Undo || e == QKeySequence::Redo) {
+        if (codeCompleter)
+            codeCompleter->popup()->hide();
+        if (e == QKeySequence::Undo)
+            undo();
+        else
+            redo();
+        return;
+    }
+
     if (codeCompleter && codeCompleter->popup()->isVisible()) {
        // The following keys are forwarded by the completer to the widget
        switch (e->key()) {
@@ -134,8 +216,16 @@ void QCodeEdit::keyPressEvent(QKeyEvent *e)
     }
 
     bool isShortcut = ((e->modifiers() & Qt::ControlModifier) && e->key() == Qt::Key_E); // CTRL+E
-    if (!codeCompleter || !isShortcut) // do not process the shortcut when we have a completer
+    if (!codeCompleter || !isShortcut) { // do not process the shortcut when we have a completer
+        // Typed characters and single deletions coalesce into one undo step.
+        const bool typing = (!e->text().isEmpty() && e->text().at(0).isPrint())
+                || ((e->key() == Qt::Key_Backspace || e->key() == Qt::Key_Delete)
+                    && !(e->modifiers() & Qt::ControlModifier));
+        const QTextCursor cursor = textCursor();
+        undoHistory->beginCapture(cursor.selectionStart(), cursor.selectionEnd(), typing);
         QPlainTextEdit::keyPressEvent(e);
+        undoHistory->endCapture();
+    }
 
     const bool ctrlOrShift = e->modifiers() & (Qt::ControlModifier | Qt::ShiftModifier);
     if (!codeCompleter || (ctrlOrShift && e->text().isEmpty()))
@@ -147,18 +237,79 @@ void QCodeEdit::keyPressEvent(QKeyEvent *e)
 
     if (!isShortcut && (hasModifier || e->text().isEmpty()|| completionPrefix.length() < 3
                       || eow.contains(e->text().right(1)))) {
+        pendingCompletionPrefix.clear();
         codeCompleter->popup()->hide();
         return;
     }
 
-    if (completionPrefix != codeCompleter->completionPrefix()) {
-        codeCompleter->setCompletionPrefix(completionPrefix);
-        codeCompleter->popup()->setCurrentIndex(codeCompleter->completionModel()->index(0, 0));
+    // Answered by showCompletions() once the engine has ranked the candidates.
+    pendingCompletionPrefix = completionPrefix;
+    QCODE_PROBE_BEGIN(completionSpan, "completion");
+    completionEngine->complete(completionPrefix);
+}
+
+void QCodeEdit::contextMenuEvent(QContextMenuEvent *e)
+{
+    QMenu *menu = createStandardContextMenu(e->pos());
+    for (QAction *action : menu->actions()) {
+        const QString name = action->objectName();
+        if (name != QLatin1String("edit-undo") && name != QLatin1String("edit-redo"))
+            continue;
+        // Queued, so the step runs after the capture around exec() is closed.
+        action->disconnect(SIGNAL(triggered(bool)));
+        if (name == QLatin1String("edit-undo")) {
+            action->setEnabled(undoHistory->canUndo());
+            connect(action, SIGNAL(triggered()), this, SLOT(undo()), Qt::QueuedConnection);
+        } else {
+            action->setEnabled(undoHistory->canRedo());
+            connect(action, SIGNAL(triggered()), this, SLOT(redo()), Qt::QueuedConnection);
+        }
     }
-    QRect cr = cursorRect();
-    cr.setWidth(codeCompleter->popup()->sizeHintForColumn(0)
-                + codeCompleter->popup()->verticalScrollBar()->sizeHint().width());
-    codeCompleter->complete(cr); // popup it up!
+
+    // Cut, Paste and Delete edit the selection.
+    const QTextCursor cursor = textCursor();
+    undoHistory->beginCapture(cursor.selectionStart(), cursor.selectionEnd());
+    menu->exec(e->globalPos());
+    undoHistory->endCapture();
+    delete menu;
+}
+
+void QCodeEdit::dropEvent(QDropEvent *e)
+{
+    // Moving text within the editor also removes the dragged selection.
+    const QTextCursor cursor = textCursor();
+    const int target = cursorForPosition(e->pos()).position();
+    undoHistory->beginCapture(qMin(cursor.selectionStart(), target), qMax(cursor.selectionEnd(), target));
+    QPlainTextEdit::dropEvent(e);
+    undoHistory->endCapture();
+}
+
+void QCodeEdit::inputMethodEvent(QInputMethodEvent *e)
+{
+    const QTextCursor cursor = textCursor();
+    undoHistory->beginCapture(cursor.selectionStart(), cursor.selectionEnd(), true);
+    QPlainTextEdit::inputMethodEvent(e);
+    undoHistory->endCapture();
+}
+
+void QCodeEdit::undo()
+{
+    const int position = undoHistory->undo();
+    if (position < 0)
+        return;
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(position);
+    setTextCursor(cursor);
+}
+
+void QCodeEdit::redo()
+{
+    const int position = undoHistory->redo();
+    if (position < 0)
+        return;
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(position);
+    setTextCursor(cursor);
 }
 
 void QCodeEdit::setTabSpaces(const int tabStop) {
@@ -172,6 +323,38 @@ void QCodeEdit::setFont(const QFont& font) {
 
 }
 
+void QCodeEdit::changeEvent(QEvent *e)
+{
+    QPlainTextEdit::changeEvent(e);
+    if (e->type() == QEvent::FontChange) {
+        updateDigitAtlas();
+        updateLineNumberAreaWidth(0);
+        lineNumberArea->update();
+    }
+}
+
+void QCodeEdit::updateDigitAtlas()
+{
+    const QFontMetrics metrics(font());
+    digitWidth = 0;
+    for (char digit = '0'; digit <= '9'; ++digit)
+        digitWidth = qMax(digitWidth, metrics.width(QLatin1Char(digit)));
+    lineHeight = metrics.height();
+
+    // All ten digits are rendered once; the gutter then only copies glyph cells.
+    const qreal ratio = devicePixelRatioF();
+    digitAtlas = QPixmap(QSize(digitWidth * 10, lineHeight) * ratio);
+    digitAtlas.setDevicePixelRatio(ratio);
+    digitAtlas.fill(Qt::transparent);
+
+    QPainter painter(&digitAtlas);
+    painter.setFont(font());
+    painter.setPen(marginForeground);
+    for (int digit = 0; digit < 10; ++digit)
+        painter.drawText(QRect(digit * digitWidth, 0, digitWidth, lineHeight),
+                         Qt::AlignRight | Qt::AlignTop, QString(QChar('0' + digit)));
+}
+
 int QCodeEdit::lineNumberAreaWidth()
 {
     int digits = 1;
@@ -181,25 +364,58 @@ int QCodeEdit::lineNumberAreaWidth()
         ++digits;
     }
 
-    int space = 3 + fontMetrics().width(QLatin1Char('9')) * digits;
+    int space = 3 + digitWidth * digits;
 
     return space;
 }
 
 void QCodeEdit::updateLineNumberAreaWidth(int /* newBlockCount */)
 {
-    setViewportMargins(lineNumberAreaWidth(), 0, 0, 0);
+    const int width = lineNumberAreaWidth();
+    if (width != gutterWidth) {
+        gutterWidth = width;
+        setViewportMargins(width, 0, 0, 0);
+    }
 }
 
 void QCodeEdit::updateLineNumberArea(const QRect &rect, int dy)
 {
+    // Scrolling blits the gutter and only the exposed strip gets painted.
+    // Other updates change the numbers only when lines were added or removed
+    // or the whole view was laid out again; cursor blinks and edits within a
+    // line leave the gutter alone.
     if (dy)
         lineNumberArea->scroll(0, dy);
-    else
+    else if (blockCount() != paintedBlockCount || rect.contains(viewport()->rect()))
         lineNumberArea->update(0, rect.y(), lineNumberArea->width(), rect.height());
 
     if (rect.contains(viewport()->rect()))
         updateLineNumberAreaWidth(0);
+
+    if (dy || rect.contains(viewport()->rect()))
+        updateVisibleBlocks();
+}
+
+void QCodeEdit::updateVisibleBlocks()
+{
+    QTextBlock block = firstVisibleBlock();
+    const int first = block.blockNumber();
+    int last = first - 1;
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    const int height = viewport()->height();
+
+    while (block.isValid() && top <= height) {
+        ++last;
+        top += blockBoundingRect(block).height();
+        block = block.next();
+    }
+
+    last = qMax(first, last);
+    if (first != firstVisibleBlockNumber || last != lastVisibleBlockNumber) {
+        firstVisibleBlockNumber = first;
+        lastVisibleBlockNumber = last;
+        emit visibleBlocksChanged(first, last);
+    }
 }
 
 void QCodeEdit::resizeEvent(QResizeEvent *e)
@@ -212,36 +428,216 @@ void QCodeEdit::resizeEvent(QResizeEvent *e)
 
 void QCodeEdit::highlightCurrentLine()
 {
-    QList<QTextEdit::ExtraSelection> extraSelections;
+    // The current line is painted straight into the viewport, so a cursor
+    // move only repaints the line it left and the line it entered.
+    const QRect rect = cursorLineRect();
+    if (rect != currentLineRect) {
+        viewport()->update(currentLineRect);
+        viewport()->update(rect);
+        currentLineRect = rect;
+    }
+}
+
+QRect QCodeEdit::cursorLineRect() const
+{
+    if (isReadOnly())
+        return QRect();
+    const QRect rect = blockBoundingGeometry(textCursor().block())
+            .translated(contentOffset()).toAlignedRect();
+    return QRect(0, rect.top(), viewport()->width(), rect.height());
+}
+
+void QCodeEdit::setLayerRanges(SelectionLayer layer, const LayerRangeList &ranges)
+{
+    updateLayerRects(layers[layer]);
+    layers[layer] = ranges;
+    std::stable_sort(layers[layer].begin(), layers[layer].end(), rangeLess);
+    updateLayerRects(layers[layer]);
+}
+
+void QCodeEdit::addLayerRanges(SelectionLayer layer, const LayerRangeList &ranges)
+{
+    // Search chunks arrive in document order and are simply appended; only
+    // ranges that land before the end of the layer need a merge.
+    LayerRangeList added = ranges;
+    std::stable_sort(added.begin(), added.end(), rangeLess);
+    LayerRangeList &target = layers[layer];
+    const int middle = target.size();
+    target += added;
+    if (middle > 0 && !added.isEmpty() && rangeLess(added.first(), target.at(middle - 1)))
+        std::inplace_merge(target.begin(), target.begin() + middle, target.end(), rangeLess);
+    updateLayerRects(added);
+}
+
+void QCodeEdit::clearLayer(SelectionLayer layer)
+{
+    updateLayerRects(layers[layer]);
+    layers[layer].clear();
+}
+
+void QCodeEdit::shiftLayerRanges(int position, int charsRemoved, int charsAdded)
+{
+    // Highlighter format changes move nothing.
+    if (QCodeCPP::isFormatting(document()))
+        return;
+
+    // Ranges after the edit move with the text; ranges the edit touched
+    // no longer describe it and are dropped until their owner refreshes.
+    const int delta = charsAdded - charsRemoved;
+    const int end = position + charsRemoved;
+    for (int l = 0; l < SelectionLayerCount; ++l) {
+        LayerRangeList &ranges = layers[l];
+        int kept = 0;
+        for (int i = 0; i < ranges.size(); ++i) {
+            LayerRange range = ranges.at(i);
+            if (range.position >= end)
+                range.position += delta;
+            else if (range.position + range.length > position)
+                continue;
+            ranges[kept++] = range;
+        }
+        ranges.resize(kept);
+    }
+}
+
+void QCodeEdit::visibleRange(int *first, int *last) const
+{
+    QTextBlock block = firstVisibleBlock();
+    *first = block.position();
+    *last = *first;
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    const int height = viewport()->height();
+
+    while (block.isValid() && top <= height) {
+        *last = block.position() + block.length();
+        top += blockBoundingRect(block).height();
+        block = block.next();
+    }
+}
+
+QRect QCodeEdit::rangeRect(int position, int length) const
+{
+    // Ranges are drawn on the line they start on; none of the layers
+    // needs more than that.
+    const QTextBlock block = document()->findBlock(position);
+    if (!block.isValid() || !block.isVisible() || !block.layout())
+        return QRect();
+
+    const QRectF blockRect = blockBoundingGeometry(block).translated(contentOffset());
+    if (blockRect.bottom() < 0 || blockRect.top() > viewport()->height())
+        return QRect();
+
+    const int start = position - block.position();
+    const QTextLine line = block.layout()->lineForTextPosition(start);
+    if (!line.isValid())
+        return QRect();
+
+    const int end = qMin(start + length, line.textStart() + line.textLength());
+    const qreal left = line.cursorToX(start);
+    const qreal right = qMax(line.cursorToX(qMax(start, end)),
+                             left + fontMetrics().averageCharWidth());
+    return QRectF(blockRect.left() + left, blockRect.top() + line.y(),
+                  right - left, line.height()).toAlignedRect();
+}
+
+void QCodeEdit::updateLayerRects(const LayerRangeList &ranges)
+{
+    int first, last;
+    visibleRange(&first, &last);
+
+    LayerRangeList::const_iterator it =
+            std::lower_bound(ranges.constBegin(), ranges.constEnd(), first, rangeBefore);
+    QVector<QRect> rects;
+    for (; it != ranges.constEnd() && it->position < last; ++it) {
+        if (rects.size() == MaxDirtyRects) {
+            viewport()->update();
+            return;
+        }
+        const QRect rect = rangeRect(it->position, it->length);
+        if (!rect.isEmpty())
+            rects.append(rect);
+    }
+    for (const QRect &rect : rects)
+        viewport()->update(rect);
+}
+
+void QCodeEdit::paintLayer(QPainter *painter, SelectionLayer layer, const QRect &clip)
+{
+    const LayerRangeList &ranges = layers[layer];
+    if (ranges.isEmpty())
+        return;
 
-    if (!isReadOnly()) {
-        QTextEdit::ExtraSelection selection;
-        selection.format.setBackground(currentLineBackground);
-        selection.format.setProperty(QTextFormat::FullWidthSelection, true);
-        selection.cursor = textCursor();
-        selection.cursor.clearSelection();
-        extraSelections.append(selection);
+    int first, last;
+    visibleRange(&first, &last);
+
+    LayerRangeList::const_iterator it =
+            std::lower_bound(ranges.constBegin(), ranges.constEnd(), first, rangeBefore);
+    for (; it != ranges.constEnd() && it->position < last; ++it) {
+        const QRect rect = rangeRect(it->position, it->length);
+        if (!rect.intersects(clip))
+            continue;
+
+        if (layer == SearchMatchLayer) {
+            painter->fillRect(rect, it->color);
+        } else {
+            // The wave phase follows the x coordinate, so partial repaints line up.
+            const int y = rect.bottom() - 1;
+            QPolygon wave;
+            for (int x = rect.left() & ~1; x <= rect.right() + 1; x += 2)
+                wave << QPoint(x, ((x / 2) & 1) ? y - 2 : y);
+            painter->setPen(it->color);
+            painter->drawPolyline(wave);
+        }
     }
+}
 
-    setExtraSelections(extraSelections);
+void QCodeEdit::paintEvent(QPaintEvent *e)
+{
+    QCODE_PROBE("paintEvent");
+    // Backgrounds go underneath the text, underlines on top of it.
+    {
+        QPainter painter(viewport());
+        currentLineRect = cursorLineRect();
+        if (currentLineRect.intersects(e->rect()))
+            painter.fillRect(currentLineRect & e->rect(), currentLineBackground);
+        paintLayer(&painter, SearchMatchLayer, e->rect());
+    }
+
+    QPlainTextEdit::paintEvent(e);
+
+    QPainter painter(viewport());
+    paintLayer(&painter, DiagnosticLayer, e->rect());
 }
 
 void QCodeEdit::lineNumberAreaPaintEvent(QPaintEvent *event)
 {
+    QCODE_PROBE("lineNumberAreaPaintEvent");
     QPainter painter(lineNumberArea);
     painter.fillRect(event->rect(), marginBackground);
+    paintedBlockCount = blockCount();
+
+    const qreal ratio = digitAtlas.devicePixelRatio();
+    if (ratio != lineNumberArea->devicePixelRatioF())
+        updateDigitAtlas();
 
     QTextBlock block = firstVisibleBlock();
     int blockNumber = block.blockNumber();
     int top = (int) blockBoundingGeometry(block).translated(contentOffset()).top();
     int bottom = top + (int) blockBoundingRect(block).height();
+    const int right = lineNumberArea->width();
+    const qreal cellWidth = digitWidth * digitAtlas.devicePixelRatio();
+    const qreal cellHeight = lineHeight * digitAtlas.devicePixelRatio();
 
     while (block.isValid() && top <= event->rect().bottom()) {
         if (block.isVisible() && bottom >= event->rect().top()) {
-            QString number = QString::number(blockNumber + 1);
-            painter.setPen(marginForeground);
-            painter.drawText(0, top, lineNumberArea->width(), fontMetrics().height(),
-                             Qt::AlignRight, number);
+            int number = blockNumber + 1;
+            int x = right - digitWidth;
+            do {
+                painter.drawPixmap(QRectF(x, top, digitWidth, lineHeight), digitAtlas,
+                                   QRectF((number % 10) * cellWidth, 0, cellWidth, cellHeight));
+                number /= 10;
+                x -= digitWidth;
+            } while (number);
         }
 
         block = block.next();
@@ -28,15 +28,24 @@
 #include <QObject>
 #include <QAbstractItemModel>
 #include <QCompleter>
+#include <QStringListModel>
+#include <QPixmap>
+#include <QVector>
+
+#include "qcodeprofiler.h"
 
 QT_BEGIN_NAMESPACE
 class QPaintEvent;
 class QResizeEvent;
 class QSize;
+class QTimer;
 class QWidget;
 QT_END_NAMESPACE
 
 class LineNumberArea;
+class QCodeCompletionEngine;
+class QCodeSymbolIndex;
+class QCodeUndoStack;
 
 class QCodeEdit : public QPlainTextEdit
 {
@@ -51,25 +60,94 @@ public:
     void setFont(const QFont& font);
     void setCompleter(QCompleter *completer);
     QString textUnderCursor() const;
-    QAbstractItemModel *modelFromFile(const QString& fileName);
+    QStringList wordsFromFile(const QString& fileName);
+
+    // Overlays kept apart from the document's own formats. Each layer is a
+    // list of ranges sorted by position; replacing one layer only repaints
+    // the rectangles its old and new ranges cover.
+    enum SelectionLayer {
+        DiagnosticLayer,    // wavy underline
+        SearchMatchLayer,   // background fill
+        SelectionLayerCount
+    };
+
+    struct LayerRange
+    {
+        int position;
+        int length;
+        QColor color;
+    };
+    typedef QVector<LayerRange> LayerRangeList;
+
+    void setLayerRanges(SelectionLayer layer, const LayerRangeList &ranges);
+    void addLayerRanges(SelectionLayer layer, const LayerRangeList &ranges);
+    void clearLayer(SelectionLayer layer);
+    const LayerRangeList &layerRanges(SelectionLayer layer) const { return layers[layer]; }
+
+    // Replaces the document's own undo history. Code that edits the
+    // document directly wraps the edit in beginCapture()/endCapture().
+    QCodeUndoStack *undoStack() const { return undoHistory; }
+
+public slots:
+    // Hide QPlainTextEdit's, which act on the disabled document history.
+    void undo();
+    void redo();
+
+signals:
+    void visibleBlocksChanged(int first, int last);
 
 protected:
     void resizeEvent(QResizeEvent *event);
     void focusInEvent(QFocusEvent *e);
     void keyPressEvent(QKeyEvent *e);
+    void changeEvent(QEvent *e);
+    void paintEvent(QPaintEvent *e);
+    void contextMenuEvent(QContextMenuEvent *e);
+    void dropEvent(QDropEvent *e);
+    void inputMethodEvent(QInputMethodEvent *e);
 
 private slots:
     void updateLineNumberAreaWidth(int newBlockCount);
     void highlightCurrentLine();
     void updateLineNumberArea(const QRect &, int);
     void insertCompletion(const QString& completion);
+    void showCompletions(const QString &prefix, const QStringList &completions);
+    void refreshDocumentWords();
+    void shiftLayerRanges(int position, int charsRemoved, int charsAdded);
 
 private:
+    void updateVisibleBlocks();
+    void updateDigitAtlas();
+    QRect cursorLineRect() const;
+    QRect rangeRect(int position, int length) const;
+    void visibleRange(int *first, int *last) const;
+    void updateLayerRects(const LayerRangeList &ranges);
+    void paintLayer(QPainter *painter, SelectionLayer layer, const QRect &clip);
+
     QWidget *lineNumberArea;
     QColor marginForeground;
     QColor marginBackground;
     QColor currentLineBackground;
     QCompleter *codeCompleter;
+    QCodeCompletionEngine *completionEngine;
+    QStringListModel *completionModel;
+    QCodeSymbolIndex *symbolIndex;
+    QTimer *symbolRefreshTimer;
+    QCodeUndoStack *undoHistory;
+    QString pendingCompletionPrefix;
+    QCodeSpan completionSpan;
+    int firstVisibleBlockNumber;
+    int lastVisibleBlockNumber;
+
+    // Line number gutter cache.
+    QPixmap digitAtlas;
+    int digitWidth;
+    int lineHeight;
+    int gutterWidth;
+    int paintedBlockCount;
+
+    LayerRangeList layers[SelectionLayerCount];
+    QRect currentLineRect;
 };
 
 class LineNumberArea : public QWidget
@@ -0,0 +1,298 @@
+/**
+* @file  qcodefind.cpp
+* @brief Source implementing a parallel find engine for QCodeEdit documents.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodefind.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Large enough to amortize scheduling, small enough to keep every core busy
+// and to stream the first matches quickly.
+const int ChunkSize = 256 * 1024;
+
+// How far past its chunk a regular expression match may run.
+const int RegexLookahead = 64 * 1024;
+
+inline bool isWordChar(ushort c)
+{
+    return QChar(c).isLetterOrNumber() || c == '_';
+}
+
+// Returns the first index in [from, to) holding a or b, or -1.
+int findEither(const ushort *s, int from, int to, ushort a, ushort b)
+{
+    int i = from;
+#ifdef __SSE2__
+    const __m128i va = _mm_set1_epi16(short(a));
+    const __m128i vb = _mm_set1_epi16(short(b));
+    for (; i + 8 <= to; i += 8) {
+        const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        const __m128i hits = _mm_or_si128(_mm_cmpeq_epi16(chars, va), _mm_cmpeq_epi16(chars, vb));
+        const uint mask = uint(_mm_movemask_epi8(hits));
+        if (mask)
+            return i + int(qCountTrailingZeroBits(mask)) / 2;
+    }
+#endif
+    for (; i < to; ++i) {
+        if (s[i] == a || s[i] == b)
+            return i;
+    }
+    return -1;
+}
+
+inline bool equalAt(const ushort *s, const ushort *p, int length, bool caseSensitive)
+{
+    if (caseSensitive)
+        return std::equal(p, p + length, s);
+    for (int i = 0; i < length; ++i) {
+        if (s[i] != p[i] && QChar::toCaseFolded(s[i]) != QChar::toCaseFolded(p[i]))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+QCodeFindEngine::QCodeFindEngine(QObject *parent)
+    : QObject(parent)
+{
+    watcher = new QFutureWatcher<MatchList>(this);
+    connect(watcher, SIGNAL(resultsReadyAt(int,int)), this, SLOT(chunksReady(int,int)));
+    connect(watcher, SIGNAL(finished()), this, SLOT(searchFinished()));
+}
+
+QCodeFindEngine::~QCodeFindEngine()
+{
+    watcher->cancel();
+    watcher->waitForFinished();
+}
+
+void QCodeFindEngine::find(const QString &text, const QString &pattern, Options options)
+{
+    cancel();
+    if (pattern.isEmpty()) {
+        emit finished(0);
+        return;
+    }
+    watcher->setFuture(QtConcurrent::mapped(split(prepare(text, pattern, options)),
+                                            &QCodeFindEngine::searchChunk));
+}
+
+void QCodeFindEngine::cancel()
+{
+    // Swapping in an empty future also drops results already queued for delivery.
+    watcher->cancel();
+    watcher->setFuture(QFuture<MatchList>());
+    found.clear();
+}
+
+void QCodeFindEngine::chunksReady(int begin, int end)
+{
+    for (int i = begin; i < end; ++i) {
+        const MatchList matches = watcher->resultAt(i);
+        if (matches.isEmpty())
+            continue;
+        found += matches;
+        emit matchesFound(matches);
+    }
+}
+
+void QCodeFindEngine::searchFinished()
+{
+    if (watcher->isCanceled())
+        return;
+
+    // Chunks finish in any order.
+    std::sort(found.begin(), found.end(), [](const Match &a, const Match &b) {
+        return a.position < b.position;
+    });
+    removeOverlaps(&found);
+    emit finished(found.size());
+}
+
+QCodeFindEngine::MatchList QCodeFindEngine::findAll(const QString &text, const QString &pattern, Options options)
+{
+    MatchList matches;
+    if (pattern.isEmpty())
+        return matches;
+
+    const QList<MatchList> parts = QtConcurrent::blockingMapped<QList<MatchList> >(
+                split(prepare(text, pattern, options)), &QCodeFindEngine::searchChunk);
+    for (const MatchList &part : parts)
+        matches += part;
+    removeOverlaps(&matches);
+    return matches;
+}
+
+QString QCodeFindEngine::patternError(const QString &pattern, Options options)
+{
+    if (!(options & RegularExpression))
+        return QString();
+    const QRegularExpression regex(pattern);
+    return regex.isValid() ? QString() : regex.errorString();
+}
+
+QRegularExpression QCodeFindEngine::expression(const QString &pattern, Options options)
+{
+    QRegularExpression::PatternOptions patternOptions = QRegularExpression::MultilineOption;
+    if (!(options & CaseSensitive))
+        patternOptions |= QRegularExpression::CaseInsensitiveOption;
+    return QRegularExpression((options & WholeWords) ? QString("\\b(?:%1)\\b").arg(pattern) : pattern,
+                              patternOptions);
+}
+
+QCodeFindEngine::SearchPointer QCodeFindEngine::prepare(const QString &text, const QString &pattern, Options options)
+{
+    QSharedPointer<Search> search(new Search);
+    search->text = text;
+    search->pattern = pattern;
+    search->options = options;
+    if (options & RegularExpression) {
+        search->regex = expression(pattern, options);
+        search->regex.optimize();
+    }
+    return search;
+}
+
+QVector<QCodeFindEngine::Chunk> QCodeFindEngine::split(SearchPointer search)
+{
+    // A chunk owns the matches that start inside it. Regular expressions
+    // may look at whole lines, so their chunks end on line breaks.
+    QVector<Chunk> chunks;
+    const QString &text = search->text;
+    const bool lineAligned = search->options & RegularExpression;
+    int begin = 0;
+    while (begin < text.size()) {
+        int end = qMin(begin + ChunkSize, text.size());
+        if (lineAligned && end < text.size()) {
+            const int lineEnd = text.indexOf(QLatin1Char('\n'), end);
+            end = lineEnd < 0 ? text.size() : lineEnd + 1;
+        }
+        Chunk chunk;
+        chunk.search = search;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.append(chunk);
+        begin = end;
+    }
+    return chunks;
+}
+
+QCodeFindEngine::MatchList QCodeFindEngine::searchChunk(const Chunk &chunk)
+{
+    const Search &search = *chunk.search;
+    if (search.options & RegularExpression)
+        return searchRegex(search, chunk.begin, chunk.end);
+    return searchLiteral(search, chunk.begin, chunk.end);
+}
+
+QCodeFindEngine::MatchList QCodeFindEngine::searchLiteral(const Search &search, int begin, int end)
+{
+    MatchList matches;
+    const ushort *s = search.text.utf16();
+    const ushort *p = search.pattern.utf16();
+    const int size = search.text.size();
+    const int length = search.pattern.size();
+    const bool caseSensitive = search.options & CaseSensitive;
+    const bool wholeWords = search.options & WholeWords;
+
+    // Candidates are found by their first character, in either case.
+    const ushort a = caseSensitive ? p[0] : QChar::toLower(p[0]);
+    const ushort b = caseSensitive ? p[0] : QChar::toUpper(p[0]);
+    const int last = qMin(end, size - length + 1);
+
+    int i = begin;
+    while (i < last) {
+        i = findEither(s, i, last, a, b);
+        if (i < 0)
+            break;
+        if (equalAt(s + i, p, length, caseSensitive)
+                && (!wholeWords || ((i == 0 || !isWordChar(s[i - 1]))
+                                    && (i + length == size || !isWordChar(s[i + length]))))) {
+            Match match;
+            match.position = i;
+            match.length = length;
+            matches.append(match);
+            i += length;
+        } else {
+            ++i;
+        }
+    }
+    return matches;
+}
+
+QCodeFindEngine::MatchList QCodeFindEngine::searchRegex(const Search &search, int begin, int end)
+{
+    MatchList matches;
+    if (!search.regex.isValid())
+        return matches;
+
+    // Each chunk only matches against its own lines plus a bounded run of
+    // the following ones, so a chunk without matches costs no more than
+    // its size. Both ends fall on line breaks, which keeps ^ and $ right;
+    // a lookbehind cannot see past the start of the chunk.
+    const QString &text = search.text;
+    int subjectEnd = end;
+    if (subjectEnd < text.size()) {
+        const int lineEnd = text.indexOf(QLatin1Char('\n'), qMin(end + RegexLookahead, text.size() - 1));
+        subjectEnd = lineEnd < 0 ? text.size() : lineEnd + 1;
+    }
+
+    QRegularExpressionMatchIterator it = search.regex.globalMatch(text.midRef(begin, subjectEnd - begin));
+    while (it.hasNext()) {
+        const QRegularExpressionMatch result = it.next();
+        if (begin + result.capturedStart() >= end)
+            break;
+        if (result.capturedLength() == 0)
+            continue;
+        Match match;
+        match.position = begin + result.capturedStart();
+        match.length = result.capturedLength();
+        matches.append(match);
+    }
+    return matches;
+}
+
+void QCodeFindEngine::removeOverlaps(MatchList *matches)
+{
+    // A match running past the end of its chunk can overlap one found by
+    // the next chunk; the earlier match wins, as in a sequential scan.
+    int kept = 0;
+    int reached = 0;
+    for (int i = 0; i < matches->size(); ++i) {
+        const Match match = matches->at(i);
+        if (match.position < reached)
+            continue;
+        (*matches)[kept++] = match;
+        reached = match.position + match.length;
+    }
+    matches->resize(kept);
+}
@@ -0,0 +1,118 @@
+/**
+* @file  qcodefind.h
+* @brief Header implementing a parallel find engine for QCodeEdit documents.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODEFIND_H
+#define QCODEFIND_H
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+// Searches a snapshot of the document text on the thread pool. The text is
+// cut into chunks that are scanned concurrently; literal patterns use a
+// vectorized scan for their first character, other patterns fall back to
+// QRegularExpression. Matches are reported chunk by chunk as they are found.
+class QCodeFindEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Option {
+        NoOptions = 0x0,
+        CaseSensitive = 0x1,
+        WholeWords = 0x2,
+        RegularExpression = 0x4
+    };
+    Q_DECLARE_FLAGS(Options, Option)
+
+    struct Match
+    {
+        int position;
+        int length;
+    };
+    typedef QVector<Match> MatchList;
+
+    QCodeFindEngine(QObject *parent = 0);
+    ~QCodeFindEngine();
+
+    // Asynchronous; reported through matchesFound() and finished().
+    void find(const QString &text, const QString &pattern, Options options);
+    void cancel();
+    bool isRunning() const { return watcher->isRunning(); }
+
+    // All matches in document order, valid after finished().
+    const MatchList &matches() const { return found; }
+
+    // Same search, blocking until every chunk is done.
+    static MatchList findAll(const QString &text, const QString &pattern, Options options);
+
+    // Empty unless the pattern is a regular expression that does not compile.
+    static QString patternError(const QString &pattern, Options options);
+
+    // The expression a RegularExpression search runs, options applied.
+    static QRegularExpression expression(const QString &pattern, Options options);
+
+signals:
+    void matchesFound(const QCodeFindEngine::MatchList &matches);
+    void finished(int count);
+
+private slots:
+    void chunksReady(int begin, int end);
+    void searchFinished();
+
+private:
+    struct Search
+    {
+        QString text;
+        QString pattern;
+        Options options;
+        QRegularExpression regex;
+    };
+    typedef QSharedPointer<const Search> SearchPointer;
+
+    struct Chunk
+    {
+        SearchPointer search;
+        int begin;
+        int end;
+    };
+
+    static SearchPointer prepare(const QString &text, const QString &pattern, Options options);
+    static QVector<Chunk> split(SearchPointer search);
+    static MatchList searchChunk(const Chunk &chunk);
+    static MatchList searchLiteral(const Search &search, int begin, int end);
+    static MatchList searchRegex(const Search &search, int begin, int end);
+    static void removeOverlaps(MatchList *matches);
+
+    QFutureWatcher<MatchList> *watcher;
+    MatchList found;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QCodeFindEngine::Options)
+Q_DECLARE_TYPEINFO(QCodeFindEngine::Match, Q_PRIMITIVE_TYPE);
+
+#endif // QCODEFIND_H
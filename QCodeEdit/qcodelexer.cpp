@@ -0,0 +1,219 @@
+/**
+* @file  qcodelexer.cpp
+* @brief Source implementing a single-pass tokenizer for CMM source lines.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodelexer.h"
+#include "qcodesymbolindex.h"
+
+#include <cstring>
+
+namespace {
+
+const char *const keywords[] = {
+    "if", "else", "for", "while", "do", "break", "continue", "return",
+    "int", "double", "bool", "void", "string", "infix", "true", "false"
+};
+
+inline bool isIdentStart(ushort c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isIdentChar(ushort c)
+{
+    return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline bool isOperatorChar(ushort c)
+{
+    switch (c) {
+    case '\\': case '=': case '^': case '$': case '?': case '|':
+    case '*': case '+': case '-': case '/': case '<': case '>': case '@':
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline void append(QCodeLexer::TokenList *tokens, int start, int length, QCodeLexer::TokenKind kind)
+{
+    QCodeLexer::Token token;
+    token.start = start;
+    token.length = length;
+    token.kind = quint8(kind);
+    tokens->append(token);
+}
+
+} // namespace
+
+QCodeBlockData::~QCodeBlockData()
+{
+    if (symbolIndex)
+        symbolIndex->releaseSymbols(symbols);
+}
+
+bool QCodeLexer::isKeyword(const QChar *text, int length)
+{
+    if (length < 2 || length > 8)
+        return false;
+    for (const char *keyword : keywords) {
+        if (int(std::strlen(keyword)) != length || text[0].unicode() != ushort(keyword[0]))
+            continue;
+        int i = 1;
+        while (i < length && text[i].unicode() == ushort(keyword[i]))
+            ++i;
+        if (i == length)
+            return true;
+    }
+    return false;
+}
+
+quint64 QCodeLexer::hashText(const QString &text)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const ushort *s = text.utf16();
+    const ushort *end = s + text.length();
+    while (s != end)
+        hash = (hash ^ *s++) * Q_UINT64_C(1099511628211);
+    return hash;
+}
+
+int QCodeLexer::tokenize(const QChar *text, int length, int state, TokenList *tokens)
+{
+    tokens->clear();
+    const ushort *s = reinterpret_cast<const ushort *>(text);
+    int i = 0;
+
+    if (state == InComment) {
+        int start = i;
+        while (i < length && !(s[i] == '*' && i + 1 < length && s[i + 1] == '/'))
+            ++i;
+        if (i >= length) {
+            append(tokens, start, length - start, MultiLineComment);
+            return InComment;
+        }
+        i += 2;
+        append(tokens, start, i - start, MultiLineComment);
+    }
+
+    while (i < length) {
+        const ushort c = s[i];
+        const int start = i;
+
+        if (isIdentStart(c)) {
+            while (i < length && isIdentChar(s[i]))
+                ++i;
+            if (isKeyword(text + start, i - start))
+                append(tokens, start, i - start, Keyword);
+            else if (i < length && s[i] == '(')
+                append(tokens, start, i - start, Function);
+            else if (i + 1 < length && s[i] == '!' && s[i + 1] == '(')
+                append(tokens, start, ++i - start, DynamicFunction);
+            else
+                append(tokens, start, i - start, Identifier);
+        } else if (isDigit(c)) {
+            while (i < length && isDigit(s[i]))
+                ++i;
+            if (i + 1 < length && s[i] == '.' && isDigit(s[i + 1])) {
+                ++i;
+                while (i < length && isDigit(s[i]))
+                    ++i;
+            }
+            if (i < length && (s[i] == 'e' || s[i] == 'E')) {
+                int j = i + 1;
+                if (j < length && (s[j] == '+' || s[j] == '-'))
+                    ++j;
+                if (j < length && isDigit(s[j])) {
+                    i = j;
+                    while (i < length && isDigit(s[i]))
+                        ++i;
+                }
+            }
+            append(tokens, start, i - start, Number);
+        } else if (c == '"') {
+            ++i;
+            while (i < length && s[i] != '"')
+                i += (s[i] == '\\' && i + 1 < length) ? 2 : 1;
+            if (i < length)
+                ++i;
+            append(tokens, start, i - start, String);
+        } else if (c == '/' && i + 1 < length && s[i + 1] == '/') {
+            append(tokens, start, length - start, Comment);
+            return Normal;
+        } else if (c == '/' && i + 1 < length && s[i + 1] == '*') {
+            i += 2;
+            while (i < length && !(s[i] == '*' && i + 1 < length && s[i + 1] == '/'))
+                ++i;
+            if (i >= length) {
+                append(tokens, start, length - start, MultiLineComment);
+                return InComment;
+            }
+            i += 2;
+            append(tokens, start, i - start, MultiLineComment);
+        } else if (isOperatorChar(c)) {
+            while (i < length && isOperatorChar(s[i])
+                   && !(s[i] == '/' && i + 1 < length && (s[i + 1] == '/' || s[i + 1] == '*')))
+                ++i;
+            // Only operators glued between two operands, e.g. "a<+>b", are infix.
+            if (start > 0 && isIdentChar(s[start - 1]) && i < length && isIdentChar(s[i]))
+                append(tokens, start, i - start, InfixOperator);
+        } else {
+            ++i;
+        }
+    }
+    return Normal;
+}
+
+int QCodeLexer::scanState(const QChar *text, int length, int state)
+{
+    const ushort *s = reinterpret_cast<const ushort *>(text);
+    int i = 0;
+
+    while (i < length) {
+        if (state == InComment) {
+            while (i + 1 < length && !(s[i] == '*' && s[i + 1] == '/'))
+                ++i;
+            if (i + 1 >= length)
+                return InComment;
+            i += 2;
+            state = Normal;
+        } else if (s[i] == '"') {
+            ++i;
+            while (i < length && s[i] != '"')
+                i += (s[i] == '\\' && i + 1 < length) ? 2 : 1;
+            ++i;
+        } else if (s[i] == '/' && i + 1 < length && s[i + 1] == '/') {
+            return Normal;
+        } else if (s[i] == '/' && i + 1 < length && s[i + 1] == '*') {
+            i += 2;
+            state = InComment;
+        } else {
+            ++i;
+        }
+    }
+    return state;
+}
@@ -0,0 +1,121 @@
+/**
+* @file  qcodelexer.h
+* @brief Header implementing a single-pass tokenizer for CMM source lines.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODELEXER_H
+#define QCODELEXER_H
+
+#include <QPointer>
+#include <QString>
+#include <QStringList>
+#include <QTextBlock>
+#include <QVector>
+
+class QCodeSymbolIndex;
+
+class QCodeLexer
+{
+public:
+    enum TokenKind {
+        Keyword,
+        Number,
+        Identifier,
+        Function,
+        DynamicFunction,
+        InfixOperator,
+        String,
+        Comment,
+        MultiLineComment,
+        TokenKindCount
+    };
+
+    // Lexer state carried from one line to the next.
+    enum State {
+        Normal = 0,
+        InComment = 1
+    };
+
+    struct Token
+    {
+        int start;
+        int length;
+        quint8 kind;
+    };
+    typedef QVector<Token> TokenList;
+
+    // Scans one line in a single pass and returns the state at its end.
+    // Safe to call from any thread.
+    static int tokenize(const QChar *text, int length, int state, TokenList *tokens);
+    static int tokenize(const QString &text, int state, TokenList *tokens) {
+        return tokenize(text.constData(), text.length(), state, tokens);
+    }
+
+    // Computes only the end-of-line state, skipping token output.
+    static int scanState(const QChar *text, int length, int state);
+    static int scanState(const QString &text, int state) {
+        return scanState(text.constData(), text.length(), state);
+    }
+
+    static bool isKeyword(const QChar *text, int length);
+
+    // 64-bit FNV-1a; a cached block is only reused when this matches, so
+    // it has to be strong enough that a collision after an edit is not a
+    // practical concern.
+    static quint64 hashText(const QString &text);
+};
+
+Q_DECLARE_TYPEINFO(QCodeLexer::Token, Q_PRIMITIVE_TYPE);
+
+// Per-block token cache; a block whose text and entry state are unchanged
+// is formatted straight from here without being scanned again. Blocks
+// outside the viewport in lazy mode only keep their states.
+class QCodeBlockData : public QTextBlockUserData
+{
+public:
+    QCodeBlockData()
+        : textHash(0), textLength(-1), entryState(-1), exitState(QCodeLexer::Normal),
+          formatted(false), pending(false), symbolsHash(0),
+          symbolsEntryState(QCodeLexer::Normal), symbolsExitState(QCodeLexer::Normal) {}
+    ~QCodeBlockData();
+
+    bool isValidFor(const QString &text, quint64 hash, int state) const {
+        return textLength == text.length() && textHash == hash && entryState == state;
+    }
+
+    QCodeLexer::TokenList tokens;
+    quint64 textHash;
+    int textLength;
+    int entryState;
+    int exitState;
+    bool formatted;     // tokens match the text, not only the states
+    bool pending;
+
+    // Identifiers this block contributes to the symbol index, and the
+    // comment states the index scanned it with.
+    QPointer<QCodeSymbolIndex> symbolIndex;
+    QStringList symbols;
+    quint64 symbolsHash;
+    int symbolsEntryState;
+    int symbolsExitState;
+};
+
+#endif // QCODELEXER_H
@@ -0,0 +1,215 @@
+/**
+* @file  qcodeprofiler.cpp
+* @brief Source implementing optional timing probes for the editor hot paths.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodeprofiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+
+QCodeProfiler::QCodeProfiler()
+    : nextEvent(0), lastSpan(0)
+{
+    clock.start();
+    events.reserve(EventCapacity);
+}
+
+QCodeProfiler *QCodeProfiler::instance()
+{
+    static QCodeProfiler profiler;
+    return &profiler;
+}
+
+int QCodeProfiler::probeId(const char *name)
+{
+    return instance()->registerProbe(name);
+}
+
+int QCodeProfiler::registerProbe(const char *name)
+{
+    QMutexLocker locker(&mutex);
+    const QByteArray key(name);
+    QHash<QByteArray, int>::const_iterator it = ids.constFind(key);
+    if (it != ids.constEnd())
+        return it.value();
+
+    Histogram histogram;
+    std::memset(&histogram, 0, sizeof(histogram));
+    histograms.append(histogram);
+    names.append(key);
+    ids.insert(key, names.size() - 1);
+    return names.size() - 1;
+}
+
+void QCodeProfiler::record(int id, qint64 startNs, qint64 endNs)
+{
+    const qint64 duration = endNs - startNs;
+    const quint64 us = quint64(duration / 1000);
+    int bucket = us ? 63 - qCountLeadingZeroBits(us) : 0;
+    bucket = qMin(bucket, int(BucketCount) - 1);
+
+    Event event;
+    event.id = id;
+    event.startNs = startNs;
+    event.durationNs = duration;
+    event.thread = quintptr(QThread::currentThreadId());
+
+    QMutexLocker locker(&mutex);
+    Histogram &histogram = histograms[id];
+    ++histogram.count;
+    histogram.totalNs += duration;
+    histogram.maxNs = qMax(histogram.maxNs, duration);
+    ++histogram.buckets[bucket];
+
+    if (events.size() < EventCapacity)
+        events.append(event);
+    else
+        events[nextEvent] = event;
+    nextEvent = (nextEvent + 1) % EventCapacity;
+}
+
+QCodeSpan QCodeProfiler::begin(int id)
+{
+    const qint64 start = now();
+    QMutexLocker locker(&mutex);
+    openSpans.insert(++lastSpan, qMakePair(id, start));
+    return lastSpan;
+}
+
+void QCodeProfiler::end(QCodeSpan span)
+{
+    const qint64 finish = now();
+    QPair<int, qint64> open;
+    {
+        QMutexLocker locker(&mutex);
+        QHash<QCodeSpan, QPair<int, qint64> >::iterator it = openSpans.find(span);
+        if (it == openSpans.end())
+            return;
+        open = it.value();
+        openSpans.erase(it);
+    }
+    record(open.first, open.second, finish);
+}
+
+void QCodeProfiler::abandon(QCodeSpan span)
+{
+    if (!span)
+        return;
+    QMutexLocker locker(&mutex);
+    openSpans.remove(span);
+}
+
+void QCodeProfiler::reset()
+{
+    QMutexLocker locker(&mutex);
+    for (Histogram &histogram : histograms)
+        std::memset(&histogram, 0, sizeof(histogram));
+    events.clear();
+    nextEvent = 0;
+    openSpans.clear();
+}
+
+qint64 QCodeProfiler::percentileUs(const Histogram &histogram, double fraction)
+{
+    // Upper edge of the bucket the percentile falls in.
+    const quint64 rank = quint64(fraction * histogram.count);
+    quint64 seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket) {
+        seen += histogram.buckets[bucket];
+        if (seen > rank)
+            return qint64(2) << bucket;
+    }
+    return histogram.maxNs / 1000;
+}
+
+QString QCodeProfiler::summary(int maxProbes) const
+{
+    QMutexLocker locker(&mutex);
+    QVector<int> order;
+    for (int id = 0; id < histograms.size(); ++id) {
+        if (histograms.at(id).count)
+            order.append(id);
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return histograms.at(a).totalNs > histograms.at(b).totalNs;
+    });
+
+    QStringList parts;
+    for (int i = 0; i < order.size() && i < maxProbes; ++i) {
+        const Histogram &histogram = histograms.at(order.at(i));
+        parts << QString("%1 n=%2 p50<%3us p99<%4us max %5ms")
+                 .arg(QString::fromLatin1(names.at(order.at(i))))
+                 .arg(histogram.count)
+                 .arg(percentileUs(histogram, 0.5))
+                 .arg(percentileUs(histogram, 0.99))
+                 .arg(histogram.maxNs / 1e6, 0, 'f', 1);
+    }
+    return parts.join(" | ");
+}
+
+bool QCodeProfiler::writeChromeTrace(const QString &fileName, QString *errorString) const
+{
+    QJsonArray traceEvents;
+    {
+        QMutexLocker locker(&mutex);
+        QHash<quintptr, int> threads;
+        for (int i = 0; i < events.size(); ++i) {
+            // Oldest first once the ring has wrapped.
+            const Event &event = events.at(events.size() < EventCapacity ? i : (nextEvent + i) % EventCapacity);
+            if (!threads.contains(event.thread))
+                threads.insert(event.thread, threads.size() + 1);
+
+            QJsonObject object;
+            object.insert("name", QString::fromLatin1(names.at(event.id)));
+            object.insert("ph", QString("X"));
+            object.insert("ts", event.startNs / 1000.0);
+            object.insert("dur", event.durationNs / 1000.0);
+            object.insert("pid", 1);
+            object.insert("tid", threads.value(event.thread));
+            traceEvents.append(object);
+        }
+    }
+
+    QJsonObject trace;
+    trace.insert("traceEvents", traceEvents);
+    trace.insert("displayTimeUnit", QString("ms"));
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorString = file.errorString();
+        return false;
+    }
+    if (file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact)) < 0) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,150 @@
+/**
+* @file  qcodeprofiler.h
+* @brief Header implementing optional timing probes for the editor hot paths.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODEPROFILER_H
+#define QCODEPROFILER_H
+
+#include <QtGlobal>
+
+// Probes are compiled in only with CONFIG += profiling, which defines
+// QCODEEDIT_PROFILING; otherwise every QCODE_PROBE macro expands to nothing.
+//
+//   QCODE_PROBE("name");               times the enclosing scope
+//   QCODE_PROBE_BEGIN(span, "name");   starts a span that ends in another function
+//   QCODE_PROBE_END(span);
+//
+// span is a QCodeSpan, usually a member, that holds the open span until it
+// ends. Spans of the same name may overlap as long as each has its own
+// QCodeSpan; beginning again on one that is still open abandons it.
+
+typedef quint64 QCodeSpan;     // 0 when no span is open
+
+#ifdef QCODEEDIT_PROFILING
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Collects probe timings into per-probe log2 histograms and a bounded ring
+// of trace events that can be written out in Chrome's trace format.
+class QCodeProfiler
+{
+public:
+    static QCodeProfiler *instance();
+    static int probeId(const char *name);
+
+    qint64 now() const { return clock.nsecsElapsed(); }
+    void record(int id, qint64 startNs, qint64 endNs);
+    QCodeSpan begin(int id);
+    void end(QCodeSpan span);
+    void abandon(QCodeSpan span);
+    void reset();
+
+    // One line with the probes that took the most time in total.
+    QString summary(int maxProbes) const;
+    bool writeChromeTrace(const QString &fileName, QString *errorString) const;
+
+private:
+    QCodeProfiler();
+
+    enum {
+        BucketCount = 32,           // bucket n holds durations below 2^(n+1) microseconds
+        EventCapacity = 200000
+    };
+
+    struct Histogram
+    {
+        quint64 count;
+        qint64 totalNs;
+        qint64 maxNs;
+        quint32 buckets[BucketCount];
+    };
+
+    struct Event
+    {
+        int id;
+        qint64 startNs;
+        qint64 durationNs;
+        quintptr thread;
+    };
+
+    int registerProbe(const char *name);
+    static qint64 percentileUs(const Histogram &histogram, double fraction);
+
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    QHash<QByteArray, int> ids;
+    QVector<QByteArray> names;
+    QVector<Histogram> histograms;
+    QVector<Event> events;
+    int nextEvent;
+    QCodeSpan lastSpan;
+    QHash<QCodeSpan, QPair<int, qint64> > openSpans;    // probe id and start
+};
+
+class QCodeProbe
+{
+public:
+    explicit QCodeProbe(int id) : id(id), start(QCodeProfiler::instance()->now()) {}
+    ~QCodeProbe() {
+        QCodeProfiler *profiler = QCodeProfiler::instance();
+        profiler->record(id, start, profiler->now());
+    }
+
+private:
+    int id;
+    qint64 start;
+};
+
+#define QCODE_PROBE_CONCAT2(a, b) a##b
+#define QCODE_PROBE_CONCAT(a, b) QCODE_PROBE_CONCAT2(a, b)
+
+#define QCODE_PROBE(name) \
+    static const int QCODE_PROBE_CONCAT(qcodeProbeId, __LINE__) = QCodeProfiler::probeId(name); \
+    QCodeProbe QCODE_PROBE_CONCAT(qcodeProbe, __LINE__)(QCODE_PROBE_CONCAT(qcodeProbeId, __LINE__))
+#define QCODE_PROBE_BEGIN(span, name) \
+    do { \
+        static const int qcodeProbeId = QCodeProfiler::probeId(name); \
+        QCodeProfiler::instance()->abandon(span); \
+        (span) = QCodeProfiler::instance()->begin(qcodeProbeId); \
+    } while (false)
+#define QCODE_PROBE_END(span) \
+    do { \
+        QCodeProfiler::instance()->end(span); \
+        (span) = 0; \
+    } while (false)
+
+#else
+
+#define QCODE_PROBE(name)
+#define QCODE_PROBE_BEGIN(span, name) do {} while (false)
+#define QCODE_PROBE_END(span) do {} while (false)
+
+#endif // QCODEEDIT_PROFILING
+
+#endif // QCODEPROFILER_H
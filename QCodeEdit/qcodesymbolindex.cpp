@@ -0,0 +1,133 @@
+/**
+* @file  qcodesymbolindex.cpp
+* @brief Source implementing an incrementally maintained index of document identifiers.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodesymbolindex.h"
+#include "qcodelexer.h"
+
+#include <QTextDocument>
+
+QCodeSymbolIndex::QCodeSymbolIndex(QTextDocument *document)
+    : QObject(document), document(document), changed(false)
+{
+    connect(document, SIGNAL(contentsChange(int,int,int)), this, SLOT(updateBlocks(int,int,int)));
+    updateBlocks(0, 0, document->characterCount());
+}
+
+void QCodeSymbolIndex::updateBlocks(int position, int /* charsRemoved */, int charsAdded)
+{
+    // Blocks deleted by this edit have already released their symbols.
+    QTextBlock block = document->findBlock(position);
+    const QTextBlock last = document->findBlock(position + charsAdded);
+
+    // The index tracks comment states itself rather than reading the
+    // highlighter's, which may lag behind in the background modes.
+    int state = QCodeLexer::Normal;
+    const QCodeBlockData *previous = static_cast<const QCodeBlockData *>(block.previous().userData());
+    if (previous && previous->symbolIndex == this)
+        state = previous->symbolsExitState;
+
+    // Past the edit, opening or closing a comment changes what the
+    // following blocks contribute, as far as the state keeps changing.
+    bool pastEdit = false;
+    while (block.isValid()) {
+        if (pastEdit) {
+            const QCodeBlockData *data = static_cast<const QCodeBlockData *>(block.userData());
+            if (data && data->symbolIndex == this && data->symbolsEntryState == state)
+                break;
+        }
+        state = updateBlock(block, state);
+        if (block == last)
+            pastEdit = true;
+        block = block.next();
+    }
+    if (changed) {
+        changed = false;
+        emit symbolsChanged();
+    }
+}
+
+int QCodeSymbolIndex::updateBlock(QTextBlock block, int state)
+{
+    QCodeBlockData *data = static_cast<QCodeBlockData *>(block.userData());
+    if (!data) {
+        data = new QCodeBlockData;
+        block.setUserData(data);
+    }
+
+    // Highlighter format updates also arrive as contentsChange.
+    const QString text = block.text();
+    const quint64 hash = QCodeLexer::hashText(text);
+    if (data->symbolIndex == this && data->symbolsHash == hash && data->symbolsEntryState == state)
+        return data->symbolsExitState;
+
+    QCodeLexer::TokenList tokens;
+    const int exitState = QCodeLexer::tokenize(text, state, &tokens);
+
+    QStringList symbols;
+    foreach (const QCodeLexer::Token &token, tokens) {
+        int length = token.length;
+        if (token.kind == QCodeLexer::DynamicFunction)
+            --length;
+        else if (token.kind != QCodeLexer::Identifier && token.kind != QCodeLexer::Function)
+            continue;
+        if (length > 1)
+            symbols.append(text.mid(token.start, length));
+    }
+    symbols.removeDuplicates();
+
+    if (data->symbolIndex == this)
+        releaseSymbols(data->symbols);
+    foreach (const QString &symbol, symbols)
+        addSymbol(symbol);
+
+    data->symbolIndex = this;
+    data->symbols = symbols;
+    data->symbolsHash = hash;
+    data->symbolsEntryState = state;
+    data->symbolsExitState = exitState;
+    return exitState;
+}
+
+void QCodeSymbolIndex::releaseSymbols(const QStringList &symbols)
+{
+    foreach (const QString &symbol, symbols)
+        removeSymbol(symbol);
+}
+
+void QCodeSymbolIndex::addSymbol(const QString &symbol)
+{
+    int &count = counts[symbol];
+    if (count++ == 0)
+        changed = true;
+}
+
+void QCodeSymbolIndex::removeSymbol(const QString &symbol)
+{
+    QHash<QString, int>::iterator it = counts.find(symbol);
+    if (it == counts.end())
+        return;
+    if (--it.value() == 0) {
+        counts.erase(it);
+        changed = true;
+    }
+}
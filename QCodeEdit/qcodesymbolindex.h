@@ -0,0 +1,67 @@
+/**
+* @file  qcodesymbolindex.h
+* @brief Header implementing an incrementally maintained index of document identifiers.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODESYMBOLINDEX_H
+#define QCODESYMBOLINDEX_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+
+#include <QTextBlock>
+
+QT_BEGIN_NAMESPACE
+class QTextDocument;
+QT_END_NAMESPACE
+
+// Counts the identifiers of every block of a document. Each edit only
+// rescans the blocks it touched, and the ones after them for as long as
+// their comment state changes; a block's previous identifiers live in its
+// QCodeBlockData and are released when the block changes or is deleted.
+class QCodeSymbolIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    QCodeSymbolIndex(QTextDocument *document);
+
+    QStringList symbols() const { return counts.keys(); }
+    void releaseSymbols(const QStringList &symbols);
+
+signals:
+    void symbolsChanged();
+
+private slots:
+    void updateBlocks(int position, int charsRemoved, int charsAdded);
+
+private:
+    int updateBlock(QTextBlock block, int state);
+    void addSymbol(const QString &symbol);
+    void removeSymbol(const QString &symbol);
+
+    QTextDocument *document;
+    QHash<QString, int> counts;
+    bool changed;
+};
+
+#endif // QCODESYMBOLINDEX_H
@@ -0,0 +1,522 @@
+/**
+* @file  qcodeundo.cpp
+* @brief Source implementing a memory-budgeted undo history for the editor.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "qcodeundo.h"
+#include "qcodecpp.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QTemporaryFile>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+namespace {
+
+const qint64 DefaultBudget = 32 * 1024 * 1024;
+const qint64 MaxSpillBytes = Q_INT64_C(1024) * 1024 * 1024;
+
+// Rough heap cost of a step and a delta besides their text.
+const int StepOverhead = 64;
+const int DeltaOverhead = 48;
+
+// Longest run of typing or deleting merged into one step.
+const int MaxCoalescedLength = 256;
+
+QString textAt(QTextDocument *document, int position, int length)
+{
+    if (length <= 0)
+        return QString();
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    return cursor.selectedText().replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+}
+
+} // namespace
+
+QCodeUndoStack::QCodeUndoStack(QTextDocument *document, QObject *parent)
+    : QObject(parent),
+      document(document),
+      current(0),
+      budget(DefaultBudget),
+      usedBytes(0),
+      spillFile(0),
+      enabled(true),
+      applying(false),
+      lastStepOpen(false),
+      couldUndo(false),
+      couldRedo(false),
+      captureDepth(0),
+      captureTyping(false),
+      captureExplicit(false),
+      windowValid(false),
+      windowStart(0)
+{
+    document->setUndoRedoEnabled(false);
+    connect(document, SIGNAL(contentsChange(int,int,int)), this, SLOT(contentsChange(int,int,int)));
+}
+
+QCodeUndoStack::~QCodeUndoStack()
+{
+    delete spillFile;
+}
+
+void QCodeUndoStack::beginCapture(int from, int to, bool typing)
+{
+    if (captureDepth++ > 0)
+        return;
+    captureTyping = typing;
+    captureExplicit = false;
+    captured.clear();
+    windowValid = enabled;
+    if (!enabled)
+        return;
+
+    // One block either side, so joining lines with Backspace or Delete
+    // stays inside the window.
+    QTextBlock first = document->findBlock(qMin(from, to));
+    if (!first.isValid())
+        first = document->firstBlock();
+    else if (first.previous().isValid())
+        first = first.previous();
+    QTextBlock last = document->findBlock(qMax(from, to));
+    if (!last.isValid())
+        last = document->lastBlock();
+    else if (last.next().isValid())
+        last = last.next();
+
+    windowStart = first.position();
+    const int windowEnd = qMin(last.position() + last.length(), document->characterCount() - 1);
+    windowText = textAt(document, windowStart, windowEnd - windowStart);
+}
+
+void QCodeUndoStack::beginExplicitCapture()
+{
+    if (captureDepth++ > 0)
+        return;
+    captureTyping = false;
+    captureExplicit = enabled;
+    captured.clear();
+    windowValid = false;
+}
+
+void QCodeUndoStack::recordEdit(int position, int removedLength, const QString &inserted)
+{
+    if (captureDepth > 0 && captureExplicit)
+        record(position, textAt(document, position, removedLength), inserted);
+}
+
+void QCodeUndoStack::endCapture()
+{
+    if (captureDepth == 0 || --captureDepth > 0)
+        return;
+    windowText = QString();
+    captureExplicit = false;
+    if (captured.isEmpty())
+        return;
+
+    dropRedo();
+    if (!captureTyping || captured.size() != 1 || !coalesce(captured.first())) {
+        Step step;
+        step.deltas = captured;
+        step.bytes = StepOverhead;
+        for (const Delta &delta : captured)
+            step.bytes += sizeOf(delta);
+        step.spillOffset = -1;
+        step.spillLength = 0;
+        step.inMemory = true;
+        step.typing = captureTyping;
+        steps.append(step);
+        current = steps.size();
+        usedBytes += step.bytes;
+    }
+    lastStepOpen = captureTyping;
+    captured.clear();
+
+    enforceBudget();
+    updateAvailability();
+}
+
+void QCodeUndoStack::contentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if (applying || !enabled || QCodeCPP::isFormatting(document))
+        return;
+
+    // The document's final paragraph separator is sometimes counted in,
+    // but it never changes.
+    const int end = document->characterCount() - 1;
+    if (position + charsAdded > end) {
+        const int over = position + charsAdded - end;
+        charsAdded -= over;
+        charsRemoved = qMax(0, charsRemoved - over);
+    }
+
+    // The caller of an explicit capture records its edits itself.
+    if (captureDepth > 0 && captureExplicit)
+        return;
+
+    if (captureDepth > 0 && windowValid) {
+        const int offset = position - windowStart;
+        if (offset >= 0 && offset + charsRemoved <= windowText.length()) {
+            const QString removed = windowText.mid(offset, charsRemoved);
+            const QString inserted = textAt(document, position, charsAdded);
+            windowText.replace(offset, charsRemoved, inserted);
+            record(position, removed, inserted);
+            return;
+        }
+    }
+
+    // What this change removed is not known, so the steps recorded so far
+    // no longer fit the text.
+    windowValid = false;
+    clear();
+}
+
+void QCodeUndoStack::record(int position, QString removed, QString inserted)
+{
+    // The document reports whole blocks for some edits; only the part
+    // that really differs is kept.
+    int prefix = 0;
+    const int shorter = qMin(removed.length(), inserted.length());
+    while (prefix < shorter && removed.at(prefix) == inserted.at(prefix))
+        ++prefix;
+    int suffix = 0;
+    while (suffix < shorter - prefix
+           && removed.at(removed.length() - 1 - suffix) == inserted.at(inserted.length() - 1 - suffix))
+        ++suffix;
+    if (prefix == removed.length() && prefix == inserted.length())
+        return;
+
+    removed = removed.mid(prefix, removed.length() - prefix - suffix);
+    inserted = inserted.mid(prefix, inserted.length() - prefix - suffix);
+
+    Delta delta;
+    delta.position = position + prefix;
+    delta.removedLength = removed.length();
+    delta.insertedLength = inserted.length();
+    delta.removed = removed.toUtf8();
+    delta.inserted = inserted.toUtf8();
+    captured.append(delta);
+}
+
+bool QCodeUndoStack::coalesce(const Delta &delta)
+{
+    if (!lastStepOpen || current == 0 || current != steps.size())
+        return false;
+    Step &step = steps[current - 1];
+    if (!step.typing || !step.inMemory || step.deltas.size() != 1)
+        return false;
+
+    Delta &last = step.deltas[0];
+    if (delta.removedLength == 0 && last.removedLength == 0) {
+        if (delta.position != last.position + last.insertedLength || delta.inserted.contains('\n')
+                || last.insertedLength + delta.insertedLength > MaxCoalescedLength)
+            return false;
+        last.inserted += delta.inserted;
+        last.insertedLength += delta.insertedLength;
+    } else if (delta.insertedLength == 0 && last.insertedLength == 0) {
+        if (delta.removed.contains('\n') || last.removedLength + delta.removedLength > MaxCoalescedLength)
+            return false;
+        if (delta.position + delta.removedLength == last.position) {
+            // Backspace
+            last.removed.prepend(delta.removed);
+            last.position = delta.position;
+        } else if (delta.position == last.position) {
+            // Delete
+            last.removed += delta.removed;
+        } else {
+            return false;
+        }
+        last.removedLength += delta.removedLength;
+    } else {
+        return false;
+    }
+
+    const qint64 bytes = StepOverhead + sizeOf(last);
+    usedBytes += bytes - step.bytes;
+    step.bytes = bytes;
+    step.spillOffset = -1;
+    return true;
+}
+
+qint64 QCodeUndoStack::sizeOf(const Delta &delta)
+{
+    return DeltaOverhead + delta.removed.size() + delta.inserted.size();
+}
+
+int QCodeUndoStack::undo()
+{
+    if (current == 0 || captureDepth > 0)
+        return -1;
+    if (!load(current - 1)) {
+        clear();
+        return -1;
+    }
+
+    const QVector<Delta> deltas = steps.at(current - 1).deltas;
+    applying = true;
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    for (int i = deltas.size() - 1; i >= 0; --i) {
+        const Delta &delta = deltas.at(i);
+        cursor.setPosition(delta.position);
+        cursor.setPosition(delta.position + delta.insertedLength, QTextCursor::KeepAnchor);
+        cursor.insertText(QString::fromUtf8(delta.removed));
+    }
+    cursor.endEditBlock();
+    applying = false;
+
+    --current;
+    lastStepOpen = false;
+    enforceBudget();
+    updateAvailability();
+    return deltas.first().position + deltas.first().removedLength;
+}
+
+int QCodeUndoStack::redo()
+{
+    if (current == steps.size() || captureDepth > 0)
+        return -1;
+    if (!load(current)) {
+        clear();
+        return -1;
+    }
+
+    const QVector<Delta> deltas = steps.at(current).deltas;
+    applying = true;
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+    for (const Delta &delta : deltas) {
+        cursor.setPosition(delta.position);
+        cursor.setPosition(delta.position + delta.removedLength, QTextCursor::KeepAnchor);
+        cursor.insertText(QString::fromUtf8(delta.inserted));
+    }
+    cursor.endEditBlock();
+    applying = false;
+
+    ++current;
+    lastStepOpen = false;
+    enforceBudget();
+    updateAvailability();
+    return deltas.last().position + deltas.last().insertedLength;
+}
+
+void QCodeUndoStack::clear()
+{
+    steps.clear();
+    captured.clear();
+    current = 0;
+    usedBytes = 0;
+    lastStepOpen = false;
+    delete spillFile;
+    spillFile = 0;
+    updateAvailability();
+}
+
+void QCodeUndoStack::setEnabled(bool enabled)
+{
+    this->enabled = enabled;
+    windowValid = false;
+    clear();
+}
+
+void QCodeUndoStack::setMemoryBudget(qint64 bytes)
+{
+    budget = qMax(Q_INT64_C(0), bytes);
+    enforceBudget();
+}
+
+qint64 QCodeUndoStack::spilledBytes() const
+{
+    return spillFile ? spillFile->size() : 0;
+}
+
+void QCodeUndoStack::dropRedo()
+{
+    for (int i = current; i < steps.size(); ++i) {
+        if (steps.at(i).inMemory)
+            usedBytes -= steps.at(i).bytes;
+    }
+    steps.resize(current);
+}
+
+void QCodeUndoStack::dropOldest(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (steps.at(i).inMemory)
+            usedBytes -= steps.at(i).bytes;
+    }
+    steps.remove(0, count);
+    current -= count;
+}
+
+void QCodeUndoStack::enforceBudget()
+{
+    // The steps farthest from the current position are needed last. The
+    // ones right next to it stay, so a single undo or redo never waits for
+    // the disk.
+    while (usedBytes > budget) {
+        int low = 0;
+        while (low < current - 1 && !steps.at(low).inMemory)
+            ++low;
+        int high = steps.size() - 1;
+        while (high > current && !steps.at(high).inMemory)
+            --high;
+
+        int index = -1;
+        if (low < current - 1)
+            index = low;
+        if (high > current && (index < 0 || high - current > current - 1 - low))
+            index = high;
+        if (index < 0)
+            break;
+
+        if (!spill(index)) {
+            // Without room on disk the oldest history goes after all.
+            if (index >= current)
+                break;
+            dropOldest(index + 1);
+        }
+    }
+}
+
+bool QCodeUndoStack::spill(int index)
+{
+    Step &step = steps[index];
+    if (step.spillOffset < 0) {
+        if (!spillFile) {
+            spillFile = new QTemporaryFile(QDir::tempPath() + "/qcodeedit-undo-XXXXXX");
+            if (!spillFile->open()) {
+                delete spillFile;
+                spillFile = 0;
+                return false;
+            }
+        }
+        // Dropped steps leave their bytes behind; once those make up half
+        // the file, or it is full, the live steps move to a fresh one.
+        qint64 offset = spillFile->size();
+        qint64 live = 0;
+        for (const Step &other : steps) {
+            if (other.spillOffset >= 0)
+                live += other.spillLength;
+        }
+        const qint64 dead = offset - live;
+        if (dead > 0 && (2 * dead > offset || offset + step.bytes > MaxSpillBytes) && compactSpillFile())
+            offset = spillFile->size();
+        if (offset + step.bytes > MaxSpillBytes || !spillFile->seek(offset))
+            return false;
+
+        QDataStream out(spillFile);
+        out << qint32(step.deltas.size());
+        for (const Delta &delta : step.deltas) {
+            out << qint32(delta.position) << qint32(delta.removedLength) << qint32(delta.insertedLength)
+                << delta.removed << delta.inserted;
+        }
+        if (out.status() != QDataStream::Ok)
+            return false;
+        step.spillOffset = offset;
+        step.spillLength = spillFile->pos() - offset;
+    }
+
+    step.deltas = QVector<Delta>();
+    step.inMemory = false;
+    usedBytes -= step.bytes;
+    return true;
+}
+
+bool QCodeUndoStack::compactSpillFile()
+{
+    QTemporaryFile *file = new QTemporaryFile(QDir::tempPath() + "/qcodeedit-undo-XXXXXX");
+    if (!file->open()) {
+        delete file;
+        return false;
+    }
+
+    // The old file stays in use until every live step is copied.
+    QVector<qint64> offsets(steps.size(), -1);
+    for (int i = 0; i < steps.size(); ++i) {
+        const Step &step = steps.at(i);
+        if (step.spillOffset < 0)
+            continue;
+        QByteArray bytes;
+        if (spillFile->seek(step.spillOffset))
+            bytes = spillFile->read(step.spillLength);
+        offsets[i] = file->pos();
+        if (bytes.size() != step.spillLength || file->write(bytes) != bytes.size()) {
+            delete file;
+            return false;
+        }
+    }
+
+    for (int i = 0; i < steps.size(); ++i)
+        steps[i].spillOffset = offsets.at(i);
+    delete spillFile;
+    spillFile = file;
+    return true;
+}
+
+bool QCodeUndoStack::load(int index)
+{
+    Step &step = steps[index];
+    if (step.inMemory)
+        return true;
+    if (!spillFile || !spillFile->seek(step.spillOffset))
+        return false;
+
+    QDataStream in(spillFile);
+    qint32 count;
+    in >> count;
+    QVector<Delta> deltas;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 position;
+        qint32 removedLength;
+        qint32 insertedLength;
+        Delta delta;
+        in >> position >> removedLength >> insertedLength >> delta.removed >> delta.inserted;
+        delta.position = position;
+        delta.removedLength = removedLength;
+        delta.insertedLength = insertedLength;
+        deltas.append(delta);
+    }
+    if (in.status() != QDataStream::Ok || deltas.isEmpty())
+        return false;
+
+    step.deltas = deltas;
+    step.inMemory = true;
+    usedBytes += step.bytes;
+    return true;
+}
+
+void QCodeUndoStack::updateAvailability()
+{
+    if (canUndo() != couldUndo) {
+        couldUndo = canUndo();
+        emit undoAvailable(couldUndo);
+    }
+    if (canRedo() != couldRedo) {
+        couldRedo = canRedo();
+        emit redoAvailable(couldRedo);
+    }
+}
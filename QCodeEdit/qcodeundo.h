@@ -0,0 +1,143 @@
+/**
+* @file  qcodeundo.h
+* @brief Header implementing a memory-budgeted undo history for the editor.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef QCODEUNDO_H
+#define QCODEUNDO_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QTemporaryFile;
+class QTextDocument;
+QT_END_NAMESPACE
+
+// Undo history kept in place of the document's own, which grows without
+// bound. The editor opens a capture window around each edit; the window's
+// text is copied first, so whatever an edit removes inside it can be
+// stored. Edits are kept as UTF-8 deltas and runs of typed characters or
+// deletions coalesce into one step. Once the steps take more than the
+// memory budget, those farthest from the current position are written to
+// a temporary file and read back when undo or redo reaches them.
+//
+// A text change made outside any capture cannot be undone correctly, so
+// it clears the history. The highlighter's format changes are not edits
+// and are ignored.
+class QCodeUndoStack : public QObject
+{
+    Q_OBJECT
+
+public:
+    QCodeUndoStack(QTextDocument *document, QObject *parent = 0);
+    ~QCodeUndoStack();
+
+    // Everything edited between these calls is one step, and has to stay
+    // within the blocks around [from, to]. Captures may nest.
+    void beginCapture(int from, int to, bool typing = false);
+    void endCapture();
+
+    // For edits whose positions the caller knows up front, such as Replace
+    // All: no window is copied and document changes are not looked at.
+    // Call recordEdit() just before each edit; endCapture() closes the step.
+    void beginExplicitCapture();
+    void recordEdit(int position, int removedLength, const QString &inserted);
+
+    bool isEnabled() const { return enabled; }
+    bool canUndo() const { return current > 0; }
+    bool canRedo() const { return current < steps.size(); }
+
+    qint64 memoryBudget() const { return budget; }
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryUsed() const { return usedBytes; }
+    qint64 spilledBytes() const;
+
+public slots:
+    // Both return where the cursor belongs afterwards, or -1.
+    int undo();
+    int redo();
+    void clear();
+    void setEnabled(bool enabled);
+
+signals:
+    void undoAvailable(bool available);
+    void redoAvailable(bool available);
+
+private slots:
+    void contentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    struct Delta
+    {
+        int position;
+        int removedLength;      // in QChars
+        int insertedLength;
+        QByteArray removed;     // UTF-8
+        QByteArray inserted;
+    };
+
+    struct Step
+    {
+        QVector<Delta> deltas;  // empty while spilled
+        qint64 bytes;
+        qint64 spillOffset;     // -1 until written to the spill file
+        qint64 spillLength;
+        bool inMemory;
+        bool typing;
+    };
+
+    void record(int position, QString removed, QString inserted);
+    bool coalesce(const Delta &delta);
+    static qint64 sizeOf(const Delta &delta);
+    void dropRedo();
+    void dropOldest(int count);
+    void enforceBudget();
+    bool spill(int index);
+    bool compactSpillFile();
+    bool load(int index);
+    void updateAvailability();
+
+    QTextDocument *document;
+    QVector<Step> steps;
+    int current;                // steps before this index can be undone
+    qint64 budget;
+    qint64 usedBytes;
+    QTemporaryFile *spillFile;
+    bool enabled;
+    bool applying;
+    bool lastStepOpen;          // typing may still be merged into the last step
+    bool couldUndo;
+    bool couldRedo;
+
+    int captureDepth;
+    bool captureTyping;
+    bool captureExplicit;
+    bool windowValid;
+    int windowStart;
+    QString windowText;
+    QVector<Delta> captured;
+};
+
+#endif // QCODEUNDO_H
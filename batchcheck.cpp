@@ -0,0 +1,145 @@
+/**
+* @file  batchcheck.cpp
+* @brief Source implementing the headless command-line checker.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "batchcheck.h"
+#include "projectchecker.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <cstdio>
+
+int BatchCheck::run(const QStringList &arguments)
+{
+    QElapsedTimer elapsed;
+    elapsed.start();
+
+    QStringList paths;
+    QString outputName;
+    int jobs = 0;
+    bool usageError = false;
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString &argument = arguments.at(i);
+        if (argument == "--check")
+            continue;
+        if (argument == "--jobs" || argument == "--output") {
+            if (i + 1 == arguments.size()) {
+                usageError = true;
+                break;
+            }
+            if (argument == "--jobs") {
+                jobs = arguments.at(++i).toInt();
+                usageError = usageError || jobs <= 0;
+            } else {
+                outputName = arguments.at(++i);
+            }
+        } else if (argument.startsWith("--")) {
+            usageError = true;
+        } else {
+            paths << argument;
+        }
+    }
+    if (usageError || paths.isEmpty()) {
+        std::fprintf(stderr, "usage: %s --check [--jobs N] [--output file] <file or folder>...\n",
+                     qPrintable(QFileInfo(arguments.value(0)).fileName()));
+        return 2;
+    }
+
+    QFile outputFile;
+    if (outputName.isEmpty()) {
+        outputFile.open(stdout, QIODevice::WriteOnly);
+    } else {
+        outputFile.setFileName(outputName);
+        if (!outputFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(outputName), qPrintable(outputFile.errorString()));
+            return 2;
+        }
+    }
+
+    if (jobs > 0)
+        QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+
+    const QStringList files = ProjectChecker::discover(paths);
+    QFuture<FileCheck> future = QtConcurrent::mapped(files, &ProjectChecker::checkFile);
+
+    // resultAt() waits for that one file only, so each line is written as
+    // soon as every file before it is done, while later files still parse.
+    int failedFiles = 0;
+    int unreadableFiles = 0;
+    int errorCount = 0;
+    int warningCount = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        const FileCheck check = future.resultAt(i);
+
+        QJsonObject result;
+        result.insert("file", check.fileName);
+        result.insert("ms", check.elapsedMs);
+        result.insert("status", check.status);
+        if (!check.error.isEmpty()) {
+            result.insert("error", check.error);
+            ++unreadableFiles;
+        } else {
+            QJsonArray diagnostics;
+            for (const Diagnostic &diagnostic : check.diagnostics) {
+                QJsonObject entry;
+                entry.insert("severity", diagnostic.isWarning ? "warning" : "error");
+                entry.insert("line", diagnostic.row);
+                entry.insert("column", diagnostic.col);
+                entry.insert("message", diagnostic.message);
+                diagnostics.append(entry);
+                if (diagnostic.isWarning)
+                    ++warningCount;
+                else
+                    ++errorCount;
+            }
+            result.insert("diagnostics", diagnostics);
+        }
+        if (check.status != 0)
+            ++failedFiles;
+
+        outputFile.write(QJsonDocument(result).toJson(QJsonDocument::Compact));
+        outputFile.write("\n");
+        outputFile.flush();
+    }
+
+    QJsonObject summary;
+    summary.insert("files", files.size());
+    summary.insert("failed", failedFiles);
+    summary.insert("errors", errorCount);
+    summary.insert("warnings", warningCount);
+    summary.insert("ms", elapsed.nsecsElapsed() / 1e6);
+    outputFile.write(QJsonDocument(summary).toJson(QJsonDocument::Compact));
+    outputFile.write("\n");
+    outputFile.flush();
+
+    if (unreadableFiles > 0)
+        return 2;
+    return failedFiles > 0 ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+/**
+* @file  batchcheck.h
+* @brief Header implementing the headless command-line checker.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef BATCHCHECK_H
+#define BATCHCHECK_H
+
+#include <QStringList>
+
+// Checks files and folders from the command line without creating an
+// application or any widgets, in parallel, and writes one JSON object per
+// file in the order given, followed by a summary line. Exits with 0 when
+// no file has errors, 1 when one does and 2 on bad usage or when a file
+// cannot be read.
+//
+//   --check [--jobs N] [--output file] <file or folder>...
+class BatchCheck
+{
+public:
+    static int run(const QStringList &arguments);
+};
+
+#endif // BATCHCHECK_H
@@ -0,0 +1,12 @@
+TARGET = benchmarks
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += testlib
+
+include(../sources.pri)
+
+SOURCES += tst_benchmarks.cpp
+
+# run.warm starts the editor binary built next door as its run server.
+unix: DEFINES += EDITOR_BINARY=\\\"$$OUT_PWD/../QCodeEdit\\\"
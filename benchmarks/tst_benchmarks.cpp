@@ -0,0 +1,528 @@
+/**
+* @file  tst_benchmarks.cpp
+* @brief Source implementing QtTest benchmarks of the editor's hot paths.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <QtTest>
+#include <QtWidgets>
+
+#include "cmmcheck.h"
+#include "diagnosticsmodel.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "incrementalcheck.h"
+#include "programrunner.h"
+#ifdef Q_OS_UNIX
+#include "runclient.h"
+#endif
+#include "QCodeEdit/qcodecompletion.h"
+#include "QCodeEdit/qcodecpp.h"
+#include "QCodeEdit/qcodeedit.h"
+#include "QCodeEdit/qcodesymbolindex.h"
+
+#include <climits>
+
+namespace {
+
+// Cases that build a QTextDocument stop here; beyond it they measure
+// paging more than the editor.
+const qint64 DocumentSizeLimit = 64 * 1024 * 1024;
+
+} // namespace
+
+// Appends the chunks of a FileLoader to a document, as MainWindow does.
+class ChunkAppender : public QObject
+{
+    Q_OBJECT
+
+public:
+    ChunkAppender(FileLoader *loader, QTextDocument *document)
+        : loader(loader), document(document) {}
+
+public slots:
+    void append(const QString &text)
+    {
+        QTextCursor cursor(document);
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(text);
+        loader->chunkConsumed();
+    }
+
+private:
+    FileLoader *loader;
+    QTextDocument *document;
+};
+
+// Times the editor's hot paths over generated CMM sources of several sizes.
+// Every function is data driven over the sizes in QCODEEDIT_BENCH_SIZES, so
+// a single case runs as e.g. "benchmarks highlightEdit:1M".
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void highlightFull_data() { addSizes(); }
+    void highlightFull();
+    void highlightEdit_data() { addSizes(); }
+    void highlightEdit();
+    void highlightCascade_data() { addSizes(); }
+    void highlightCascade();
+    void completionIndex_data() { addSizes(); }
+    void completionIndex();
+    void completionQuery_data() { addSizes(); }
+    void completionQuery();
+    void ioSave_data() { addSizes(); }
+    void ioSave();
+    void ioOpen_data() { addSizes(); }
+    void ioOpen();
+    void parse_data() { addSizes(); }
+    void parse();
+    void incrementalCheck_data() { addSizes(); }
+    void incrementalCheck();
+    void tableFill_data() { addSizes(); }
+    void tableFill();
+    void tableSort_data() { addSizes(); }
+    void tableSort();
+    void editorPaint_data() { addSizes(); }
+    void editorPaint();
+    void runCold();
+    void runWarm();
+
+private:
+    void addSizes();
+    static qint64 parseSize(const QString &size);
+    static QString generateCorpus(qint64 size);
+    const QString &corpus(qint64 size);
+    QString corpusPath(qint64 size);
+    static DiagnosticList generateDiagnostics(const QString &corpus);
+    QString interpreter() const;
+
+    QTemporaryDir dir;
+    QList<qint64> sizes;
+    QHash<qint64, QString> corpora;
+};
+
+void Benchmarks::initTestCase()
+{
+    QVERIFY(dir.isValid());
+
+    QString sizeList = QString::fromLocal8Bit(qgetenv("QCODEEDIT_BENCH_SIZES"));
+    if (sizeList.isEmpty())
+        sizeList = "1K,64K,1M,16M";
+    for (const QString &size : sizeList.split(QLatin1Char(','), QString::SkipEmptyParts)) {
+        const qint64 bytes = parseSize(size.trimmed());
+        QVERIFY2(bytes > 0, qPrintable("bad size in QCODEEDIT_BENCH_SIZES: " + size));
+        sizes.append(bytes);
+    }
+}
+
+void Benchmarks::addSizes()
+{
+    QTest::addColumn<qint64>("size");
+    for (qint64 size : sizes) {
+        QString tag = QString::number(size);
+        if (size % (1024 * 1024) == 0)
+            tag = QString::number(size / (1024 * 1024)) + "M";
+        else if (size % 1024 == 0)
+            tag = QString::number(size / 1024) + "K";
+        QTest::newRow(qPrintable(tag)) << size;
+    }
+}
+
+qint64 Benchmarks::parseSize(const QString &size)
+{
+    qint64 unit = 1;
+    QString number = size;
+    if (size.endsWith(QLatin1Char('K'), Qt::CaseInsensitive))
+        unit = 1024;
+    else if (size.endsWith(QLatin1Char('M'), Qt::CaseInsensitive))
+        unit = 1024 * 1024;
+    else if (size.endsWith(QLatin1Char('G'), Qt::CaseInsensitive))
+        unit = 1024 * 1024 * 1024;
+    if (unit != 1)
+        number.chop(1);
+
+    bool ok = false;
+    const qint64 value = number.toLongLong(&ok);
+    return ok ? value * unit : -1;
+}
+
+QString Benchmarks::generateCorpus(qint64 size)
+{
+    // Whole functions only, so every corpus parses; the last one may run
+    // a little past the requested size.
+    static const char *const function =
+            "/* function %1 */\n"
+            "int compute%1(int count, double scale) {\n"
+            "    int total = count * %1;\n"
+            "    double ratio = scale / 2.5e3;\n"
+            "    // accumulate until the limit\n"
+            "    while (total < 1000) {\n"
+            "        total = total + count;\n"
+            "        if (total > 500) {\n"
+            "            break;\n"
+            "        }\n"
+            "    }\n"
+            "    string label = \"value %1\";\n"
+            "    return total;\n"
+            "}\n"
+            "\n";
+
+    QString text;
+    text.reserve(int(qMin<qint64>(size + 1024, INT_MAX / 2)));
+    for (int n = 0; text.size() < size; ++n)
+        text += QString::fromLatin1(function).arg(n);
+    return text;
+}
+
+const QString &Benchmarks::corpus(qint64 size)
+{
+    QHash<qint64, QString>::iterator it = corpora.find(size);
+    if (it == corpora.end())
+        it = corpora.insert(size, generateCorpus(size));
+    return it.value();
+}
+
+QString Benchmarks::corpusPath(qint64 size)
+{
+    const QString path = dir.filePath(QString("corpus-%1.cmm").arg(size));
+    if (!QFile::exists(path)) {
+        QString error;
+        if (!FileSaver::write(path, corpus(size), &error))
+            qFatal("%s: %s", qPrintable(path), qPrintable(error));
+    }
+    return path;
+}
+
+void Benchmarks::highlightFull()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    QTextDocument document;
+    document.setPlainText(corpus(size));
+    QCodeCPP highlighter(&document);
+
+    // Dropping the block caches is part of the timing, but small next to
+    // tokenizing every line again.
+    QBENCHMARK {
+        for (QTextBlock block = document.begin(); block.isValid(); block = block.next())
+            block.setUserData(0);
+        highlighter.rehighlight();
+    }
+}
+
+void Benchmarks::highlightEdit()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    QTextDocument document;
+    document.setPlainText(corpus(size));
+    QCodeCPP highlighter(&document);
+    highlighter.rehighlight();
+
+    // Typing inside a line rehighlights that line only.
+    QTextCursor cursor(document.findBlockByNumber(document.blockCount() / 2));
+    cursor.movePosition(QTextCursor::EndOfBlock);
+    QBENCHMARK {
+        cursor.insertText("x");
+        cursor.deletePreviousChar();
+    }
+}
+
+void Benchmarks::highlightCascade()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    QTextDocument document;
+    document.setPlainText(corpus(size));
+    QCodeCPP highlighter(&document);
+    highlighter.rehighlight();
+
+    // Opening a comment at the top changes the state of every line below.
+    QTextCursor cursor(&document);
+    QBENCHMARK {
+        cursor.insertText("/*");
+        cursor.deletePreviousChar();
+        cursor.deletePreviousChar();
+    }
+}
+
+void Benchmarks::completionIndex()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    QTextDocument document;
+    QCodeSymbolIndex symbols(&document);
+    document.setPlainText(corpus(size));
+    const QStringList documentWords = symbols.symbols();
+
+    // The index is built on the thread pool; timed until it is in place.
+    QCodeCompletionEngine engine;
+    QEventLoop loop;
+    connect(&engine, SIGNAL(documentWordsIndexed()), &loop, SLOT(quit()));
+    QBENCHMARK {
+        engine.setDocumentWords(documentWords);
+        loop.exec();
+    }
+}
+
+void Benchmarks::completionQuery()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    QTextDocument document;
+    QCodeSymbolIndex symbols(&document);
+    document.setPlainText(corpus(size));
+
+    QStringList words;
+    QFile wordList(":/wordlist.txt");
+    if (wordList.open(QFile::ReadOnly)) {
+        while (!wordList.atEnd())
+            words << QString::fromUtf8(wordList.readLine().trimmed());
+    }
+
+    QCodeCompletionEngine engine;
+    engine.setWords(words);
+    QEventLoop loop;
+    connect(&engine, SIGNAL(documentWordsIndexed()), &loop, SLOT(quit()));
+    engine.setDocumentWords(symbols.symbols());
+    loop.exec();
+
+    const QStringList prefixes = QStringList() << "com" << "tot" << "lab" << "ret" << "whi" << "cnt";
+    connect(&engine, SIGNAL(completionsReady(QString,QStringList)), &loop, SLOT(quit()));
+    QBENCHMARK {
+        for (const QString &prefix : prefixes) {
+            engine.complete(prefix);
+            loop.exec();
+        }
+    }
+}
+
+void Benchmarks::ioSave()
+{
+    QFETCH(qint64, size);
+
+    const QString &text = corpus(size);
+    const QString target = dir.filePath("saved.cmm");
+    QString error;
+    QBENCHMARK {
+        QVERIFY2(FileSaver::write(target, text, &error), qPrintable(error));
+    }
+    QFile::remove(target);
+}
+
+void Benchmarks::ioOpen()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    // Same path as MainWindow::openFile: streamed chunks appended at the end.
+    const QString path = corpusPath(size);
+    QBENCHMARK {
+        QTextDocument document;
+        document.setUndoRedoEnabled(false);
+        FileLoader loader(path);
+        ChunkAppender appender(&loader, &document);
+        QEventLoop loop;
+        connect(&loader, SIGNAL(chunkRead(QString)), &appender, SLOT(append(QString)));
+        connect(&loader, SIGNAL(loaded()), &loop, SLOT(quit()));
+        connect(&loader, SIGNAL(failed(QString)), &loop, SLOT(quit()));
+        loader.start();
+        loop.exec();
+        loader.wait();
+    }
+}
+
+void Benchmarks::parse()
+{
+    QFETCH(qint64, size);
+
+    const QString path = corpusPath(size);
+    DiagnosticList diagnostics;
+    QBENCHMARK {
+        diagnostics.clear();
+        CMMCheck::checkFile(path, &diagnostics);
+    }
+}
+
+void Benchmarks::incrementalCheck()
+{
+    QFETCH(qint64, size);
+
+    // One line in the middle changes between checks, as while typing; the
+    // first, full check happens before the timing starts.
+    QStringList lines = corpus(size).split(QLatin1Char('\n'));
+    const int line = lines.size() / 2;
+    const QString original = lines.at(line);
+    IncrementalCheck incremental;
+    DiagnosticList diagnostics;
+    incremental.check(lines, &diagnostics);
+
+    QBENCHMARK {
+        diagnostics.clear();
+        lines[line] = lines.at(line) == original ? original + " " : original;
+        incremental.check(lines, &diagnostics);
+    }
+}
+
+DiagnosticList Benchmarks::generateDiagnostics(const QString &corpus)
+{
+    // One diagnostic for every eight lines, a third of them warnings.
+    const int count = corpus.count(QLatin1Char('\n')) / 8;
+    DiagnosticList diagnostics;
+    diagnostics.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Diagnostic diagnostic;
+        diagnostic.isWarning = i % 3 == 0;
+        diagnostic.row = i * 8 + 1;
+        diagnostic.col = (i * 7) % 40 + 1;
+        diagnostic.message = QString("unexpected token near 'total' (%1)").arg(i);
+        diagnostics.append(diagnostic);
+    }
+    return diagnostics;
+}
+
+void Benchmarks::tableFill()
+{
+    QFETCH(qint64, size);
+
+    const DiagnosticList diagnostics = generateDiagnostics(corpus(size));
+    DiagnosticsModel model;
+    QBENCHMARK {
+        model.setDiagnostics(diagnostics);
+    }
+}
+
+void Benchmarks::tableSort()
+{
+    QFETCH(qint64, size);
+
+    DiagnosticsModel model;
+    model.setDiagnostics(generateDiagnostics(corpus(size)));
+    Qt::SortOrder order = Qt::AscendingOrder;
+    QBENCHMARK {
+        order = order == Qt::AscendingOrder ? Qt::DescendingOrder : Qt::AscendingOrder;
+        model.sort(DiagnosticsModel::MessageColumn, order);
+    }
+}
+
+void Benchmarks::editorPaint()
+{
+    QFETCH(qint64, size);
+    if (size > DocumentSizeLimit)
+        QSKIP("document size limit");
+
+    // Gutter and viewport rendered at scattered scroll positions; the
+    // scrolling itself is part of the timing.
+    QCodeEdit editor;
+    editor.setPlainText(corpus(size));
+    editor.resize(800, 600);
+    editor.show();
+    QCoreApplication::processEvents();
+
+    QPixmap pixmap(editor.size());
+    QScrollBar *scrollBar = editor.verticalScrollBar();
+    int step = 0;
+    QBENCHMARK {
+        scrollBar->setValue(int((qint64(++step) * 7919) % (scrollBar->maximum() + 1)));
+        QCoreApplication::processEvents();
+        editor.render(&pixmap);
+    }
+}
+
+QString Benchmarks::interpreter() const
+{
+    const QString interpreter = QSettings("QCodeEdit", "CMM Editor").value("run/interpreter", "cmm").toString();
+    if (!QFileInfo(interpreter).isExecutable() && QStandardPaths::findExecutable(interpreter).isEmpty())
+        return QString();
+    return interpreter;
+}
+
+void Benchmarks::runCold()
+{
+    // Start-up latency of a tiny program in a fresh interpreter process.
+    const QString program = interpreter();
+    if (program.isEmpty())
+        QSKIP("interpreter not found");
+
+    const QString path = dir.filePath("run.cmm");
+    QString error;
+    QVERIFY2(FileSaver::write(path, generateCorpus(1), &error), qPrintable(error));
+
+    ProgramRunner runner;
+    QEventLoop loop;
+    connect(&runner, SIGNAL(finished(ProgramRunner::Result)), &loop, SLOT(quit()));
+    connect(&runner, SIGNAL(failed(QString)), &loop, SLOT(quit()));
+    QBENCHMARK {
+        runner.start(program, path, QStringList());
+        loop.exec();
+    }
+}
+
+void Benchmarks::runWarm()
+{
+#ifdef Q_OS_UNIX
+    // The same program through the warm run server of the editor binary.
+    const QString program = interpreter();
+    if (program.isEmpty())
+        QSKIP("interpreter not found");
+    if (!QFileInfo(EDITOR_BINARY).isExecutable())
+        QSKIP("editor binary not built");
+
+    const QString source = generateCorpus(1);
+    const QString path = dir.filePath("run.cmm");
+    QString error;
+    QVERIFY2(FileSaver::write(path, source, &error), qPrintable(error));
+
+    RunClient client;
+    client.setServerProgram(EDITOR_BINARY);
+    QEventLoop loop;
+    connect(&client, SIGNAL(finished(ProgramRunner::Result)), &loop, SLOT(quit()));
+    connect(&client, SIGNAL(failed(QString)), &loop, SLOT(quit()));
+
+    // The first run starts the server and is not counted.
+    client.start(program, path, source, QStringList());
+    loop.exec();
+    QBENCHMARK {
+        client.start(program, path, source, QStringList());
+        loop.exec();
+    }
+#else
+    QSKIP("run server needs Unix");
+#endif
+}
+
+QTEST_MAIN(Benchmarks)
+
+#include "tst_benchmarks.moc"
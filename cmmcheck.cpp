@@ -0,0 +1,69 @@
+/**
+* @file  cmmcheck.cpp
+* @brief Source implementing helpers that run the CMM parser and collect its diagnostics.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "cmmcheck.h"
+#include "filesaver.h"
+#include "SourceMgr.h"
+#include "CMMParser.h"
+
+#include <QDir>
+#include <QTemporaryFile>
+
+int CMMCheck::checkFile(const QString &fileName, DiagnosticList *diagnostics)
+{
+    using namespace cmm;
+
+    SourceMgr SrcMgr(fileName.toStdString(), false);
+    CMMParser Parser(SrcMgr);
+
+    int Err = Parser.parse();
+
+    for (SourceMgr::ErrorTy &Msg : SrcMgr.getErrorList()) {
+        std::pair<size_t,size_t> RowCol = SrcMgr.getLineColByLoc(std::get<0>(Msg));
+
+        Diagnostic diagnostic;
+        diagnostic.isWarning = std::get<1>(Msg) == SourceMgr::ErrorKind::Warning;
+        diagnostic.row = int(RowCol.first) + 1;
+        diagnostic.col = int(RowCol.second) + 1;
+        diagnostic.message = QString::fromStdString(std::get<2>(Msg));
+        diagnostics->append(diagnostic);
+    }
+    return Err;
+}
+
+int CMMCheck::checkLines(const QStringList &lines, DiagnosticList *diagnostics)
+{
+    // SourceMgr only reads from a path, so the snapshot goes through a
+    // private temporary file rather than the user's file on disk.
+    QTemporaryFile file(QDir::tempPath() + "/cmm-check-XXXXXX.cmm");
+    if (!file.open() || !FileSaver::writeLines(&file, lines) || !file.flush()) {
+        Diagnostic diagnostic;
+        diagnostic.isWarning = false;
+        diagnostic.row = 1;
+        diagnostic.col = 1;
+        diagnostic.message = QObject::tr("Could not write the buffer for checking: %1").arg(file.errorString());
+        diagnostics->append(diagnostic);
+        return 1;
+    }
+    return checkFile(file.fileName(), diagnostics);
+}
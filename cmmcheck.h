@@ -0,0 +1,66 @@
+/**
+* @file  cmmcheck.h
+* @brief Header implementing helpers that run the CMM parser and collect its diagnostics.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef CMMCHECK_H
+#define CMMCHECK_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct Diagnostic
+{
+    bool isWarning;
+    int row;        // 1-based
+    int col;        // 1-based
+    QString message;
+};
+
+typedef QVector<Diagnostic> DiagnosticList;
+
+// Outcome of checking one file on disk.
+struct FileCheck
+{
+    QString fileName;
+    DiagnosticList diagnostics;
+    int status;
+    double elapsedMs;
+    QString error;      // set when the file could not be read
+};
+
+typedef QVector<FileCheck> FileCheckList;
+
+// Every call builds its own SourceMgr and CMMParser, so checks may run on
+// any thread. The return value is the parser status, non-zero on errors.
+class CMMCheck
+{
+public:
+    // Part of every cached result's key; bump it whenever the parser or the
+    // diagnostics it reports change.
+    enum { ParserVersion = 1 };
+
+    static int checkFile(const QString &fileName, DiagnosticList *diagnostics);
+    static int checkLines(const QStringList &lines, DiagnosticList *diagnostics);
+};
+
+#endif // CMMCHECK_H
@@ -0,0 +1,235 @@
+/**
+* @file  diagnosticscache.cpp
+* @brief Source implementing a content-addressed cache of check results.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "diagnosticscache.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+const int MaxMemoryCost = 100000;       // diagnostics held in memory, roughly
+const int MaxDiskEntries = 2000;
+const int PruneInterval = 64;           // disk writes between prunes
+const quint32 FileMagic = 0x434d4d44;   // "CMMD"
+
+const quint64 FnvOffset = Q_UINT64_C(14695981039346656037);
+const quint64 FnvPrime = Q_UINT64_C(1099511628211);
+
+} // namespace
+
+DiagnosticsCache::DiagnosticsCache()
+    : memory(MaxMemoryCost), diskEnabled(false), diskWrites(0)
+{
+    cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/diagnostics";
+}
+
+DiagnosticsCache *DiagnosticsCache::instance()
+{
+    static DiagnosticsCache cache;
+    return &cache;
+}
+
+quint64 DiagnosticsCache::key(const QStringList &lines)
+{
+    // FNV-1a over UTF-16 units: the same on every build, so disk entries
+    // stay valid across runs.
+    quint64 hash = FnvOffset;
+    hash = (hash ^ quint64(CMMCheck::ParserVersion)) * FnvPrime;
+    for (const QString &line : lines) {
+        const ushort *s = line.utf16();
+        const ushort *end = s + line.size();
+        while (s != end)
+            hash = (hash ^ *s++) * FnvPrime;
+        hash = (hash ^ ushort('\n')) * FnvPrime;
+    }
+    return hash;
+}
+
+quint64 DiagnosticsCache::key(const QString &text)
+{
+    quint64 hash = FnvOffset;
+    hash = (hash ^ quint64(CMMCheck::ParserVersion)) * FnvPrime;
+    const ushort *s = text.utf16();
+    const ushort *end = s + text.size();
+    for (; s != end; ++s) {
+        if (*s == '\r' && s + 1 != end && s[1] == '\n')
+            continue;
+        hash = (hash ^ *s) * FnvPrime;
+    }
+    return (hash ^ ushort('\n')) * FnvPrime;
+}
+
+int DiagnosticsCache::check(const QStringList &lines, DiagnosticList *diagnostics)
+{
+    const quint64 k = key(lines);
+    int status;
+    if (lookup(k, diagnostics, &status))
+        return status;
+    status = CMMCheck::checkLines(lines, diagnostics);
+    insert(k, *diagnostics, status);
+    return status;
+}
+
+bool DiagnosticsCache::lookup(quint64 key, DiagnosticList *diagnostics, int *status)
+{
+    // The disk is only touched with the lock released, so checks running
+    // on other threads are not held up by it.
+    {
+        QMutexLocker locker(&mutex);
+        if (const Entry *entry = memory.object(key)) {
+            *diagnostics = entry->diagnostics;
+            *status = entry->status;
+            return true;
+        }
+        if (!diskEnabled)
+            return false;
+    }
+
+    Entry *entry = new Entry;
+    if (!readDisk(key, entry)) {
+        delete entry;
+        return false;
+    }
+    *diagnostics = entry->diagnostics;
+    *status = entry->status;
+
+    QMutexLocker locker(&mutex);
+    memory.insert(key, entry, 1 + entry->diagnostics.size());
+    return true;
+}
+
+void DiagnosticsCache::insert(quint64 key, const DiagnosticList &diagnostics, int status)
+{
+    Entry *entry = new Entry;
+    entry->diagnostics = diagnostics;
+    entry->status = status;
+
+    bool prune = false;
+    bool writeThrough;
+    {
+        QMutexLocker locker(&mutex);
+        writeThrough = diskEnabled;
+        if (writeThrough)
+            prune = ++diskWrites % PruneInterval == 0;
+    }
+    if (writeThrough) {
+        writeDisk(key, *entry);
+        if (prune)
+            pruneDisk();
+    }
+
+    QMutexLocker locker(&mutex);
+    memory.insert(key, entry, 1 + diagnostics.size());
+}
+
+bool DiagnosticsCache::isDiskEnabled() const
+{
+    QMutexLocker locker(&mutex);
+    return diskEnabled;
+}
+
+void DiagnosticsCache::setDiskEnabled(bool enabled)
+{
+    QMutexLocker locker(&mutex);
+    diskEnabled = enabled && QDir().mkpath(cacheDirectory);
+}
+
+QString DiagnosticsCache::directory() const
+{
+    return cacheDirectory;
+}
+
+void DiagnosticsCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    memory.clear();
+    QDir dir(cacheDirectory);
+    for (const QString &name : dir.entryList(QStringList() << "*.diag", QDir::Files))
+        dir.remove(name);
+}
+
+QString DiagnosticsCache::pathFor(quint64 key) const
+{
+    return QString("%1/%2.diag").arg(cacheDirectory).arg(key, 16, 16, QLatin1Char('0'));
+}
+
+bool DiagnosticsCache::readDisk(quint64 key, Entry *entry) const
+{
+    QFile file(pathFor(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic;
+    qint32 version;
+    quint64 storedKey;
+    qint32 status;
+    qint32 count;
+    in >> magic >> version >> storedKey >> status >> count;
+    if (in.status() != QDataStream::Ok || magic != FileMagic || version != CMMCheck::ParserVersion
+            || storedKey != key || count < 0)
+        return false;
+
+    entry->status = status;
+    entry->diagnostics.clear();
+    entry->diagnostics.reserve(count);
+    for (qint32 i = 0; i < count; ++i) {
+        Diagnostic diagnostic;
+        qint32 row;
+        qint32 col;
+        in >> diagnostic.isWarning >> row >> col >> diagnostic.message;
+        diagnostic.row = row;
+        diagnostic.col = col;
+        entry->diagnostics.append(diagnostic);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+void DiagnosticsCache::writeDisk(quint64 key, const Entry &entry) const
+{
+    // Written under a temporary name and renamed, so readers never see half a file.
+    QSaveFile file(pathFor(key));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out << FileMagic << qint32(CMMCheck::ParserVersion) << key << qint32(entry.status)
+        << qint32(entry.diagnostics.size());
+    for (const Diagnostic &diagnostic : entry.diagnostics)
+        out << diagnostic.isWarning << qint32(diagnostic.row) << qint32(diagnostic.col) << diagnostic.message;
+    file.commit();
+}
+
+void DiagnosticsCache::pruneDisk() const
+{
+    QDir dir(cacheDirectory);
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.diag", QDir::Files, QDir::Time);
+    for (int i = MaxDiskEntries; i < files.size(); ++i)
+        QFile::remove(files.at(i).absoluteFilePath());
+}
@@ -0,0 +1,82 @@
+/**
+* @file  diagnosticscache.h
+* @brief Header implementing a content-addressed cache of check results.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef DIAGNOSTICSCACHE_H
+#define DIAGNOSTICSCACHE_H
+
+#include "cmmcheck.h"
+
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+// Remembers full check results by a 64-bit hash of the program text and
+// the parser version. Recent results are kept in memory (least recently
+// used first out); with the disk tier enabled every result is also written
+// to the cache directory, so a file opened again shows its diagnostics
+// without being parsed. Safe to use from any thread.
+class DiagnosticsCache
+{
+public:
+    static DiagnosticsCache *instance();
+
+    static quint64 key(const QStringList &lines);
+    // The same key for file contents, reading "\r\n" as "\n" the way the
+    // editor does, without splitting the text into lines first.
+    static quint64 key(const QString &text);
+
+    // Cached result, or the parser's result, which is then cached.
+    int check(const QStringList &lines, DiagnosticList *diagnostics);
+
+    bool lookup(quint64 key, DiagnosticList *diagnostics, int *status);
+    void insert(quint64 key, const DiagnosticList &diagnostics, int status);
+
+    bool isDiskEnabled() const;
+    void setDiskEnabled(bool enabled);
+    QString directory() const;
+    void clear();
+
+private:
+    DiagnosticsCache();
+
+    struct Entry
+    {
+        DiagnosticList diagnostics;
+        int status;
+    };
+
+    QString pathFor(quint64 key) const;
+    bool readDisk(quint64 key, Entry *entry) const;
+    void writeDisk(quint64 key, const Entry &entry) const;
+    void pruneDisk() const;
+
+    mutable QMutex mutex;
+    QCache<quint64, Entry> memory;
+    bool diskEnabled;
+    QString cacheDirectory;
+    int diskWrites;
+};
+
+#endif // DIAGNOSTICSCACHE_H
@@ -0,0 +1,254 @@
+/**
+* @file  diagnosticsmodel.cpp
+* @brief Source implementing a table model over a flat array of parser diagnostics.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "diagnosticsmodel.h"
+
+#include <QColor>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <climits>
+
+DiagnosticsModel::DiagnosticsModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      severities(AllSeverities),
+      firstLine(0),
+      lastLine(INT_MAX),
+      sortColumn(-1),
+      sortOrder(Qt::AscendingOrder)
+{
+}
+
+void DiagnosticsModel::setDiagnostics(const DiagnosticList &diagnostics)
+{
+    beginResetModel();
+    const int count = diagnostics.size();
+    warnings.resize(count);
+    lines.resize(count);
+    columns.resize(count);
+    messages.resize(count);
+    files.fill(-1, count);
+    fileNames.clear();
+    for (int i = 0; i < count; ++i) {
+        const Diagnostic &diagnostic = diagnostics.at(i);
+        warnings[i] = diagnostic.isWarning;
+        lines[i] = diagnostic.row;
+        columns[i] = diagnostic.col;
+        messages[i] = diagnostic.message;
+    }
+    rebuildOrder();
+    endResetModel();
+}
+
+void DiagnosticsModel::appendDiagnostics(const FileCheckList &checks)
+{
+    if (fileNames.isEmpty() && !lines.isEmpty()) {
+        // Buffer diagnostics and project results are not mixed.
+        beginResetModel();
+        warnings.clear();
+        lines.clear();
+        columns.clear();
+        messages.clear();
+        files.clear();
+        order.clear();
+        endResetModel();
+    }
+
+    const int first = lines.size();
+    for (const FileCheck &check : checks) {
+        const int file = fileNames.size();
+        fileNames.append(check.fileName);
+        for (const Diagnostic &diagnostic : check.diagnostics) {
+            warnings.append(diagnostic.isWarning);
+            lines.append(diagnostic.row);
+            columns.append(diagnostic.col);
+            messages.append(diagnostic.message);
+            files.append(file);
+        }
+    }
+
+    // Only the new rows are sorted, then inserted run by run where they
+    // belong, so the view keeps its selection and scroll position.
+    QVector<int> added;
+    for (int i = first; i < lines.size(); ++i) {
+        if (accepts(i))
+            added.append(i);
+    }
+    auto less = [this](int a, int b) { return lessThan(a, b); };
+    if (sortColumn >= 0)
+        std::stable_sort(added.begin(), added.end(), less);
+
+    int next = 0;
+    while (next < added.size()) {
+        const int position = sortColumn < 0 ? order.size()
+                : int(std::upper_bound(order.begin(), order.end(), added.at(next), less) - order.begin());
+        int count = 1;
+        while (next + count < added.size()
+               && (position == order.size() || lessThan(added.at(next + count), order.at(position))))
+            ++count;
+
+        beginInsertRows(QModelIndex(), position, position + count - 1);
+        order.insert(position, count, 0);
+        std::copy(added.constBegin() + next, added.constBegin() + next + count, order.begin() + position);
+        endInsertRows();
+        next += count;
+    }
+}
+
+QString DiagnosticsModel::fileName(int row) const
+{
+    const int file = files.at(order.at(row));
+    return file < 0 ? QString() : fileNames.at(file);
+}
+
+void DiagnosticsModel::clear()
+{
+    setDiagnostics(DiagnosticList());
+}
+
+void DiagnosticsModel::setSeverityFilter(int severities)
+{
+    beginResetModel();
+    this->severities = severities;
+    rebuildOrder();
+    endResetModel();
+}
+
+void DiagnosticsModel::setLineFilter(int firstLine, int lastLine)
+{
+    beginResetModel();
+    this->firstLine = firstLine;
+    this->lastLine = lastLine;
+    rebuildOrder();
+    endResetModel();
+}
+
+void DiagnosticsModel::sort(int column, Qt::SortOrder order)
+{
+    beginResetModel();
+    sortColumn = column;
+    sortOrder = order;
+    rebuildOrder();
+    endResetModel();
+}
+
+bool DiagnosticsModel::accepts(int i) const
+{
+    const int severity = warnings.at(i) ? Warnings : Errors;
+    return (severities & severity) && lines.at(i) >= firstLine && lines.at(i) <= lastLine;
+}
+
+bool DiagnosticsModel::lessThan(int a, int b) const
+{
+    if (sortOrder == Qt::DescendingOrder)
+        std::swap(a, b);
+    if (sortColumn != MessageColumn && files.at(a) != files.at(b)) {
+        if (files.at(a) < 0 || files.at(b) < 0)
+            return files.at(a) < files.at(b);
+        return fileNames.at(files.at(a)) < fileNames.at(files.at(b));
+    }
+    switch (sortColumn) {
+    case ColColumn:
+        if (columns.at(a) != columns.at(b))
+            return columns.at(a) < columns.at(b);
+        return lines.at(a) < lines.at(b);
+    case MessageColumn:
+        return messages.at(a) < messages.at(b);
+    default:
+        if (lines.at(a) != lines.at(b))
+            return lines.at(a) < lines.at(b);
+        return columns.at(a) < columns.at(b);
+    }
+}
+
+void DiagnosticsModel::rebuildOrder()
+{
+    order.clear();
+    order.reserve(lines.size());
+    for (int i = 0; i < lines.size(); ++i) {
+        if (accepts(i))
+            order.append(i);
+    }
+
+    if (sortColumn >= 0)
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return lessThan(a, b); });
+}
+
+int DiagnosticsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : order.size();
+}
+
+int DiagnosticsModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(ColumnCount);
+}
+
+QVariant DiagnosticsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= order.size())
+        return QVariant();
+
+    const int i = order.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (index.column()) {
+        case FileColumn: {
+            const int file = files.at(i);
+            return file < 0 ? QString() : QFileInfo(fileNames.at(file)).fileName();
+        }
+        case RowColumn:
+            return lines.at(i);
+        case ColColumn:
+            return columns.at(i);
+        case MessageColumn:
+            return messages.at(i);
+        }
+        break;
+    case Qt::ToolTipRole:
+        if (index.column() == FileColumn && files.at(i) >= 0)
+            return fileNames.at(files.at(i));
+        break;
+    case Qt::BackgroundRole:
+        return warnings.at(i) ? QColor::fromRgb(255,193,37) : QColor::fromRgb(238,99,99);
+    }
+    return QVariant();
+}
+
+QVariant DiagnosticsModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    switch (section) {
+    case FileColumn:
+        return tr("File");
+    case RowColumn:
+        return tr("Row");
+    case ColColumn:
+        return tr("Column");
+    case MessageColumn:
+        return tr("Information");
+    }
+    return QVariant();
+}
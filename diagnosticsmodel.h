@@ -0,0 +1,99 @@
+/**
+* @file  diagnosticsmodel.h
+* @brief Header implementing a table model over a flat array of parser diagnostics.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef DIAGNOSTICSMODEL_H
+#define DIAGNOSTICSMODEL_H
+
+#include "cmmcheck.h"
+
+#include <QAbstractTableModel>
+#include <QVector>
+
+// Diagnostics are stored column by column. Sorting and filtering only
+// rearrange a vector of indices into those columns, so the data itself is
+// never copied, and a whole check result is loaded with a single reset.
+// Diagnostics from a project check also carry the file they belong to;
+// they stream in as row insertions into the current sort order.
+class DiagnosticsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        FileColumn,
+        RowColumn,
+        ColColumn,
+        MessageColumn,
+        ColumnCount
+    };
+
+    enum Severity {
+        Errors = 0x1,
+        Warnings = 0x2,
+        AllSeverities = Errors | Warnings
+    };
+
+    DiagnosticsModel(QObject *parent = 0);
+
+    void setDiagnostics(const DiagnosticList &diagnostics);
+    void appendDiagnostics(const FileCheckList &checks);
+    void clear();
+
+    bool hasFiles() const { return !fileNames.isEmpty(); }
+
+    void setSeverityFilter(int severities);
+    void setLineFilter(int firstLine, int lastLine);
+
+    // Location of the diagnostic shown in a view row, 1-based.
+    int line(int row) const { return lines.at(order.at(row)); }
+    int column(int row) const { return columns.at(order.at(row)); }
+    // Empty for diagnostics of the editor's own buffer.
+    QString fileName(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+private:
+    bool accepts(int i) const;
+    bool lessThan(int a, int b) const;
+    void rebuildOrder();
+
+    QVector<bool> warnings;
+    QVector<int> lines;
+    QVector<int> columns;
+    QVector<QString> messages;
+    QVector<int> files;             // index into fileNames, -1 for the buffer
+    QStringList fileNames;
+    QVector<int> order;
+
+    int severities;
+    int firstLine;
+    int lastLine;
+    int sortColumn;
+    Qt::SortOrder sortOrder;
+};
+
+#endif // DIAGNOSTICSMODEL_H
@@ -0,0 +1,18 @@
+TARGET = QCodeEdit
+
+include(sources.pri)
+
+SOURCES += main.cpp
+
+# install
+target.path = $$[QT_INSTALL_EXAMPLES]/widgets/richtext/syntaxhighlighter
+INSTALLS += target
+
+
+wince*: {
+   addFiles.files = main.cpp mainwindow.cpp
+   addFiles.path = .
+   DEPLOYMENT += addFiles
+}
+
+CONFIG += static
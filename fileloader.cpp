@@ -0,0 +1,130 @@
+/**
+* @file  fileloader.cpp
+* @brief Source implementing a worker thread that streams a file into the editor.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "fileloader.h"
+
+#include <QFile>
+#include <QScopedPointer>
+#include <QTextCodec>
+
+namespace {
+
+const qint64 ChunkSize = 1024 * 1024;
+const int MaxChunksInFlight = 4;
+
+} // namespace
+
+FileLoader::FileLoader(const QString &fileName, QObject *parent)
+    : QThread(parent), path(fileName), freeChunks(MaxChunksInFlight)
+{
+}
+
+FileLoader::~FileLoader()
+{
+    cancel();
+    wait();
+}
+
+void FileLoader::chunkConsumed()
+{
+    freeChunks.release();
+}
+
+void FileLoader::cancel()
+{
+    cancelled.store(1);
+    freeChunks.release(MaxChunksInFlight);
+}
+
+bool FileLoader::deliver(QString text, qint64 bytesRead, qint64 bytesTotal)
+{
+    freeChunks.acquire();
+    if (cancelled.load())
+        return false;
+    emit chunkRead(text);
+    emit progress(bytesRead, bytesTotal);
+    return true;
+}
+
+void FileLoader::run()
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit failed(file.errorString());
+        return;
+    }
+
+    const qint64 total = file.size();
+    uchar *mapped = total > 0 ? file.map(0, total) : 0;
+    QScopedPointer<QTextDecoder> decoder(QTextCodec::codecForName("UTF-8")->makeDecoder());
+    QByteArray buffer;
+    qint64 offset = 0;
+    bool pendingCR = false;
+
+    forever {
+        if (cancelled.load())
+            return;
+
+        qint64 count;
+        QString text;
+        if (mapped) {
+            count = qMin(ChunkSize, total - offset);
+            if (count <= 0)
+                break;
+            text = decoder->toUnicode(reinterpret_cast<const char *>(mapped + offset), int(count));
+        } else {
+            buffer.resize(int(ChunkSize));
+            count = file.read(buffer.data(), ChunkSize);
+            if (count < 0) {
+                emit failed(file.errorString());
+                return;
+            }
+            if (count == 0)
+                break;
+            text = decoder->toUnicode(buffer.constData(), int(count));
+        }
+        offset += count;
+
+        // Same line ending translation as QFile::Text, also across chunk borders.
+        if (pendingCR) {
+            text.prepend(QLatin1Char('\r'));
+            pendingCR = false;
+        }
+        if (text.endsWith(QLatin1Char('\r'))) {
+            text.chop(1);
+            pendingCR = true;
+        }
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+
+        if (!deliver(text, offset, qMax(total, offset)))
+            return;
+    }
+
+    // A lone '\r' at the very end is kept, as QFile::Text would.
+    if (pendingCR && !deliver(QString(QLatin1Char('\r')), offset, qMax(total, offset)))
+        return;
+
+    if (mapped)
+        file.unmap(mapped);
+    emit loaded();
+}
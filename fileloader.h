@@ -0,0 +1,65 @@
+/**
+* @file  fileloader.h
+* @brief Header implementing a worker thread that streams a file into the editor.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FILELOADER_H
+#define FILELOADER_H
+
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+
+// Reads a file in chunks (memory-mapped when possible) and hands the decoded
+// text out through chunkRead(). At most a few chunks are in flight at once;
+// the receiver calls chunkConsumed() after appending each one, so the file is
+// never held in memory twice.
+class FileLoader : public QThread
+{
+    Q_OBJECT
+
+public:
+    FileLoader(const QString &fileName, QObject *parent = 0);
+    ~FileLoader();
+
+    QString fileName() const { return path; }
+    void chunkConsumed();
+    void cancel();
+
+signals:
+    void chunkRead(const QString &text);
+    void progress(qint64 bytesRead, qint64 bytesTotal);
+    void loaded();
+    void failed(const QString &message);
+
+protected:
+    void run();
+
+private:
+    bool deliver(QString text, qint64 bytesRead, qint64 bytesTotal);
+
+    QString path;
+    QSemaphore freeChunks;
+    QAtomicInt cancelled;
+};
+
+#endif // FILELOADER_H
@@ -0,0 +1,125 @@
+/**
+* @file  filesaver.cpp
+* @brief Source implementing a worker thread that atomically saves a document snapshot.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "filesaver.h"
+
+#include <QSaveFile>
+#include <QTextBlock>
+#include <QTextDocument>
+
+namespace {
+
+const int WriteBufferSize = 1024 * 1024;
+
+} // namespace
+
+FileSaver::FileSaver(const QString &fileName, const QTextDocument *document, QObject *parent)
+    : QThread(parent), path(fileName), text(document->toRawText())
+{
+}
+
+FileSaver::~FileSaver()
+{
+    // A save is never abandoned half way, not even on shutdown.
+    wait();
+}
+
+QStringList FileSaver::snapshot(const QTextDocument *document)
+{
+    QStringList lines;
+    lines.reserve(document->blockCount());
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next())
+        lines.append(block.text());
+    return lines;
+}
+
+bool FileSaver::write(const QString &fileName, const QString &text, QString *errorString)
+{
+    // commit() flushes and syncs the temporary file before the rename.
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    if (!writeText(&file, text)) {
+        *errorString = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    if (!file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool FileSaver::writeText(QIODevice *device, const QString &text)
+{
+    // Raw document text separates blocks with paragraph separators, and
+    // frames with two private use characters; all become line breaks.
+    int start = 0;
+    while (start < text.size()) {
+        int length = qMin(WriteBufferSize, text.size() - start);
+        if (start + length < text.size() && text.at(start + length - 1).isHighSurrogate())
+            --length;
+
+        QString slice = text.mid(start, length);
+        for (QChar *c = slice.data(), *end = c + slice.size(); c != end; ++c) {
+            if (c->unicode() == QChar::ParagraphSeparator || c->unicode() == 0xfdd0 || c->unicode() == 0xfdd1)
+                *c = QLatin1Char('\n');
+        }
+        const QByteArray bytes = slice.toUtf8();
+        if (device->write(bytes) != bytes.size())
+            return false;
+        start += length;
+    }
+    return true;
+}
+
+bool FileSaver::writeLines(QIODevice *device, const QStringList &lines)
+{
+    QByteArray buffer;
+    buffer.reserve(WriteBufferSize + 4096);
+    for (int i = 0; i < lines.size(); ++i) {
+        if (i > 0)
+            buffer.append('\n');
+        buffer.append(lines.at(i).toUtf8());
+        if (buffer.size() >= WriteBufferSize || i == lines.size() - 1) {
+            if (device->write(buffer) != buffer.size())
+                return false;
+            buffer.resize(0);
+        }
+    }
+    return true;
+}
+
+void FileSaver::run()
+{
+    QString errorString;
+    if (write(path, text, &errorString))
+        emit saved();
+    else
+        emit failed(errorString);
+}
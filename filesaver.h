@@ -0,0 +1,68 @@
+/**
+* @file  filesaver.h
+* @brief Header implementing a worker thread that atomically saves a document snapshot.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+QT_BEGIN_NAMESPACE
+class QIODevice;
+class QTextDocument;
+QT_END_NAMESPACE
+
+// Writes a snapshot of a document to a temporary file next to the target,
+// syncs it to disk and renames it over the target, so a crash or a full
+// disk never leaves a half-written file behind. The snapshot is the raw
+// text, one copy taken on the calling thread; splitting and encoding it is
+// left to the worker.
+class FileSaver : public QThread
+{
+    Q_OBJECT
+
+public:
+    FileSaver(const QString &fileName, const QTextDocument *document, QObject *parent = 0);
+    ~FileSaver();
+
+    QString fileName() const { return path; }
+
+    static QStringList snapshot(const QTextDocument *document);
+    static bool write(const QString &fileName, const QString &text, QString *errorString);
+    static bool writeText(QIODevice *device, const QString &text);
+    static bool writeLines(QIODevice *device, const QStringList &lines);
+
+signals:
+    void saved();
+    void failed(const QString &message);
+
+protected:
+    void run();
+
+private:
+    QString path;
+    QString text;
+};
+
+#endif // FILESAVER_H
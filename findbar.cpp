@@ -0,0 +1,314 @@
+/**
+* @file  findbar.cpp
+* @brief Source implementing the find and replace bar below the editor.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <QtWidgets>
+
+#include "findbar.h"
+#include "QCodeEdit/qcodecpp.h"
+#include "QCodeEdit/qcodeedit.h"
+#include "QCodeEdit/qcodeundo.h"
+
+#include <algorithm>
+
+namespace {
+
+const QColor MatchBackground = QColor::fromRgb(255, 230, 120);
+
+bool startsBefore(const QCodeEdit::LayerRange &range, int position)
+{
+    return range.position < position;
+}
+
+} // namespace
+
+FindBar::FindBar(QCodeEdit *editor, QWidget *parent)
+    : QWidget(parent), editor(editor), streamedCount(0)
+{
+    engine = new QCodeFindEngine(this);
+    connect(engine, SIGNAL(matchesFound(QCodeFindEngine::MatchList)),
+            this, SLOT(addMatches(QCodeFindEngine::MatchList)));
+    connect(engine, SIGNAL(finished(int)), this, SLOT(searchFinished(int)));
+
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(150);
+    connect(searchTimer, SIGNAL(timeout()), this, SLOT(startSearch()));
+
+    findEdit = new QLineEdit;
+    findEdit->setPlaceholderText(tr("Find"));
+    connect(findEdit, SIGNAL(textChanged(QString)), searchTimer, SLOT(start()));
+    connect(findEdit, SIGNAL(returnPressed()), this, SLOT(findNext()));
+
+    replaceEdit = new QLineEdit;
+    replaceEdit->setPlaceholderText(tr("Replace"));
+    connect(replaceEdit, SIGNAL(returnPressed()), this, SLOT(replace()));
+
+    caseSensitive = new QCheckBox(tr("Match case"));
+    wholeWords = new QCheckBox(tr("Whole words"));
+    regularExpression = new QCheckBox(tr("Regex"));
+    connect(caseSensitive, SIGNAL(toggled(bool)), this, SLOT(startSearch()));
+    connect(wholeWords, SIGNAL(toggled(bool)), this, SLOT(startSearch()));
+    connect(regularExpression, SIGNAL(toggled(bool)), this, SLOT(startSearch()));
+
+    QPushButton *previousButton = new QPushButton(tr("Previous"));
+    QPushButton *nextButton = new QPushButton(tr("Next"));
+    QPushButton *replaceButton = new QPushButton(tr("Replace"));
+    QPushButton *replaceAllButton = new QPushButton(tr("Replace All"));
+    connect(previousButton, SIGNAL(clicked()), this, SLOT(findPrevious()));
+    connect(nextButton, SIGNAL(clicked()), this, SLOT(findNext()));
+    connect(replaceButton, SIGNAL(clicked()), this, SLOT(replace()));
+    connect(replaceAllButton, SIGNAL(clicked()), this, SLOT(replaceAll()));
+
+    status = new QLabel;
+    status->setMinimumWidth(120);
+
+    QGridLayout *layout = new QGridLayout;
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(findEdit, 0, 0);
+    layout->addWidget(previousButton, 0, 1);
+    layout->addWidget(nextButton, 0, 2);
+    layout->addWidget(caseSensitive, 0, 3);
+    layout->addWidget(wholeWords, 0, 4);
+    layout->addWidget(regularExpression, 0, 5);
+    layout->addWidget(replaceEdit, 1, 0);
+    layout->addWidget(replaceButton, 1, 1);
+    layout->addWidget(replaceAllButton, 1, 2);
+    layout->addWidget(status, 1, 3, 1, 3);
+    layout->setColumnStretch(0, 1);
+    setLayout(layout);
+
+    // Edits move the painted matches along; new text is searched once typing pauses.
+    connect(editor->document(), SIGNAL(contentsChange(int,int,int)),
+            this, SLOT(documentChanged()));
+}
+
+void FindBar::activate()
+{
+    const QTextCursor cursor = editor->textCursor();
+    if (cursor.hasSelection() && !cursor.selectedText().contains(QChar::ParagraphSeparator))
+        findEdit->setText(cursor.selectedText());
+    show();
+    findEdit->setFocus();
+    findEdit->selectAll();
+    startSearch();
+}
+
+void FindBar::deactivate()
+{
+    searchTimer->stop();
+    engine->cancel();
+    editor->clearLayer(QCodeEdit::SearchMatchLayer);
+    hide();
+    editor->setFocus();
+}
+
+void FindBar::keyPressEvent(QKeyEvent *e)
+{
+    if (e->key() == Qt::Key_Escape) {
+        deactivate();
+        return;
+    }
+    QWidget::keyPressEvent(e);
+}
+
+QCodeFindEngine::Options FindBar::options() const
+{
+    QCodeFindEngine::Options options = QCodeFindEngine::NoOptions;
+    if (caseSensitive->isChecked())
+        options |= QCodeFindEngine::CaseSensitive;
+    if (wholeWords->isChecked())
+        options |= QCodeFindEngine::WholeWords;
+    if (regularExpression->isChecked())
+        options |= QCodeFindEngine::RegularExpression;
+    return options;
+}
+
+void FindBar::startSearch()
+{
+    searchTimer->stop();
+    if (!isVisible())
+        return;
+
+    editor->clearLayer(QCodeEdit::SearchMatchLayer);
+    streamedCount = 0;
+
+    const QString pattern = findEdit->text();
+    const QString error = QCodeFindEngine::patternError(pattern, options());
+    if (!error.isEmpty()) {
+        engine->cancel();
+        status->setText(error);
+        return;
+    }
+    status->setText(pattern.isEmpty() ? QString() : tr("Searching..."));
+    engine->find(editor->toPlainText(), pattern, options());
+}
+
+void FindBar::documentChanged()
+{
+    if (QCodeCPP::isFormatting(editor->document()) || !isVisible())
+        return;
+
+    // Results still coming in belong to the old text.
+    if (engine->isRunning())
+        engine->cancel();
+    searchTimer->start();
+}
+
+void FindBar::addMatches(const QCodeFindEngine::MatchList &matches)
+{
+    QCodeEdit::LayerRangeList ranges;
+    ranges.reserve(matches.size());
+    for (const QCodeFindEngine::Match &match : matches) {
+        QCodeEdit::LayerRange range;
+        range.position = match.position;
+        range.length = match.length;
+        range.color = MatchBackground;
+        ranges.append(range);
+    }
+    editor->addLayerRanges(QCodeEdit::SearchMatchLayer, ranges);
+
+    streamedCount += matches.size();
+    status->setText(tr("%n match(es) so far", 0, streamedCount));
+}
+
+void FindBar::searchFinished(int count)
+{
+    if (findEdit->text().isEmpty()) {
+        status->clear();
+        return;
+    }
+    // Chunk borders can produce overlapping matches; the engine's final
+    // list has them removed.
+    if (count != streamedCount) {
+        QCodeEdit::LayerRangeList ranges;
+        ranges.reserve(count);
+        for (const QCodeFindEngine::Match &match : engine->matches()) {
+            QCodeEdit::LayerRange range;
+            range.position = match.position;
+            range.length = match.length;
+            range.color = MatchBackground;
+            ranges.append(range);
+        }
+        editor->setLayerRanges(QCodeEdit::SearchMatchLayer, ranges);
+    }
+    status->setText(count ? tr("%n match(es)", 0, count) : tr("No matches"));
+}
+
+void FindBar::selectRange(int position, int length)
+{
+    QTextCursor cursor = editor->textCursor();
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+    editor->centerCursor();
+}
+
+void FindBar::findNext()
+{
+    const QCodeEdit::LayerRangeList &matches = editor->layerRanges(QCodeEdit::SearchMatchLayer);
+    if (matches.isEmpty())
+        return;
+
+    const QTextCursor cursor = editor->textCursor();
+    QCodeEdit::LayerRangeList::const_iterator it =
+            std::lower_bound(matches.constBegin(), matches.constEnd(), cursor.selectionEnd(), startsBefore);
+    if (it == matches.constEnd())
+        it = matches.constBegin();
+    selectRange(it->position, it->length);
+}
+
+void FindBar::findPrevious()
+{
+    const QCodeEdit::LayerRangeList &matches = editor->layerRanges(QCodeEdit::SearchMatchLayer);
+    if (matches.isEmpty())
+        return;
+
+    const QTextCursor cursor = editor->textCursor();
+    QCodeEdit::LayerRangeList::const_iterator it =
+            std::lower_bound(matches.constBegin(), matches.constEnd(), cursor.selectionStart(), startsBefore);
+    if (it == matches.constBegin())
+        it = matches.constEnd();
+    --it;
+    selectRange(it->position, it->length);
+}
+
+void FindBar::replace()
+{
+    const QCodeEdit::LayerRangeList &matches = editor->layerRanges(QCodeEdit::SearchMatchLayer);
+    QTextCursor cursor = editor->textCursor();
+    QCodeEdit::LayerRangeList::const_iterator it =
+            std::lower_bound(matches.constBegin(), matches.constEnd(), cursor.selectionStart(), startsBefore);
+
+    // Only a selection that is exactly a match gets replaced.
+    if (cursor.hasSelection() && it != matches.constEnd() && it->position == cursor.selectionStart()
+            && it->position + it->length == cursor.selectionEnd()) {
+        editor->undoStack()->beginCapture(cursor.selectionStart(), cursor.selectionEnd());
+        cursor.insertText(replaceEdit->text());
+        editor->undoStack()->endCapture();
+        editor->setTextCursor(cursor);
+    }
+    findNext();
+}
+
+void FindBar::replaceAll()
+{
+    const QString pattern = findEdit->text();
+    if (pattern.isEmpty() || !QCodeFindEngine::patternError(pattern, options()).isEmpty())
+        return;
+
+    // Searched again on the current text, so nothing streamed in is stale.
+    engine->cancel();
+    const QString text = editor->toPlainText();
+    const QCodeFindEngine::MatchList matches = QCodeFindEngine::findAll(text, pattern, options());
+    if (matches.isEmpty()) {
+        status->setText(tr("No matches"));
+        return;
+    }
+
+    // Back to front, so earlier positions stay valid; one edit block is a
+    // single undo step and a single relayout. Each match is recorded as its
+    // own delta rather than copying the text between the first and last.
+    editor->clearLayer(QCodeEdit::SearchMatchLayer);
+    // In regex mode \1 and the like refer to the match's captures.
+    const QString replacement = replaceEdit->text();
+    const bool expand = options() & QCodeFindEngine::RegularExpression;
+    const QRegularExpression regex = expand ? QCodeFindEngine::expression(pattern, options()) : QRegularExpression();
+    QTextCursor cursor(editor->document());
+    editor->undoStack()->beginExplicitCapture();
+    cursor.beginEditBlock();
+    for (int i = matches.size() - 1; i >= 0; --i) {
+        const QCodeFindEngine::Match &match = matches.at(i);
+        const QString inserted = expand
+                ? text.mid(match.position, match.length).replace(regex, replacement) : replacement;
+        editor->undoStack()->recordEdit(match.position, match.length, inserted);
+        cursor.setPosition(match.position);
+        cursor.setPosition(match.position + match.length, QTextCursor::KeepAnchor);
+        cursor.insertText(inserted);
+    }
+    cursor.endEditBlock();
+    editor->undoStack()->endCapture();
+
+    searchTimer->stop();
+    status->setText(tr("Replaced %n match(es)", 0, matches.size()));
+}
@@ -0,0 +1,84 @@
+/**
+* @file  findbar.h
+* @brief Header implementing the find and replace bar below the editor.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef FINDBAR_H
+#define FINDBAR_H
+
+#include "QCodeEdit/qcodefind.h"
+
+#include <QWidget>
+
+class QCodeEdit;
+
+QT_BEGIN_NAMESPACE
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QTimer;
+QT_END_NAMESPACE
+
+// Searches the editor as the pattern is typed. Matches are painted in the
+// editor's search layer while the engine streams them in; navigation walks
+// that layer, so it stays right while the document is edited.
+class FindBar : public QWidget
+{
+    Q_OBJECT
+
+public:
+    FindBar(QCodeEdit *editor, QWidget *parent = 0);
+
+public slots:
+    void activate();
+    void deactivate();
+    void findNext();
+    void findPrevious();
+    void replace();
+    void replaceAll();
+
+protected:
+    void keyPressEvent(QKeyEvent *e);
+
+private slots:
+    void startSearch();
+    void documentChanged();
+    void addMatches(const QCodeFindEngine::MatchList &matches);
+    void searchFinished(int count);
+
+private:
+    QCodeFindEngine::Options options() const;
+    void selectRange(int position, int length);
+
+    QCodeEdit *editor;
+    QCodeFindEngine *engine;
+    QLineEdit *findEdit;
+    QLineEdit *replaceEdit;
+    QCheckBox *caseSensitive;
+    QCheckBox *wholeWords;
+    QCheckBox *regularExpression;
+    QLabel *status;
+    QTimer *searchTimer;
+    int streamedCount;
+};
+
+#endif // FINDBAR_H
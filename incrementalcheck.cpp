@@ -0,0 +1,189 @@
+/**
+* @file  incrementalcheck.cpp
+* @brief Source implementing a check that only reparses changed top-level declarations.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "incrementalcheck.h"
+
+namespace {
+
+uint hashLines(const QStringList &lines)
+{
+    uint hash = uint(lines.size());
+    foreach (const QString &line, lines)
+        hash = hash * 31 + qHash(line);
+    return hash;
+}
+
+} // namespace
+
+QVector<IncrementalCheck::Segment> IncrementalCheck::splitTopLevel(const QStringList &lines)
+{
+    QVector<Segment> segments;
+    int depth = 0;
+    bool inComment = false;
+    int start = 0;
+    bool hasCode = false;
+
+    for (int lineNo = 0; lineNo < lines.size(); ++lineNo) {
+        const QString &line = lines.at(lineNo);
+        const int length = line.length();
+        ushort last = 0;
+
+        for (int i = 0; i < length; ++i) {
+            const ushort c = line.at(i).unicode();
+            if (inComment) {
+                if (c == '*' && i + 1 < length && line.at(i + 1) == QLatin1Char('/')) {
+                    inComment = false;
+                    ++i;
+                }
+            } else if (c == '/' && i + 1 < length && line.at(i + 1) == QLatin1Char('/')) {
+                break;
+            } else if (c == '/' && i + 1 < length && line.at(i + 1) == QLatin1Char('*')) {
+                inComment = true;
+                ++i;
+            } else if (c == '"') {
+                for (++i; i < length && line.at(i) != QLatin1Char('"'); ++i) {
+                    if (line.at(i) == QLatin1Char('\\'))
+                        ++i;
+                }
+                last = c;
+            } else if (c != ' ' && c != '\t') {
+                if (c == '{')
+                    ++depth;
+                else if (c == '}')
+                    depth = qMax(0, depth - 1);
+                last = c;
+            }
+        }
+
+        if (last)
+            hasCode = true;
+
+        // A declaration ends on a line that closes it at file scope. Blank and
+        // comment-only lines in between stick to the declaration that follows.
+        if (hasCode && depth == 0 && !inComment && (last == '}' || last == ';')) {
+            Segment segment;
+            segment.firstLine = start;
+            segment.lineCount = lineNo - start + 1;
+            segments.append(segment);
+            start = lineNo + 1;
+            hasCode = false;
+        }
+    }
+
+    if (start < lines.size()) {
+        Segment segment;
+        segment.firstLine = start;
+        segment.lineCount = lines.size() - start;
+        segments.append(segment);
+    }
+    return segments;
+}
+
+int IncrementalCheck::check(const QStringList &lines, DiagnosticList *diagnostics)
+{
+    const QVector<Segment> segments = splitTopLevel(lines);
+    QVector<QStringList> segmentLines(segments.size());
+    QVector<uint> hashes(segments.size());
+    QVector<const Entry *> entries(segments.size(), 0);
+    int changed = 0;
+
+    for (int i = 0; i < segments.size(); ++i) {
+        segmentLines[i] = lines.mid(segments.at(i).firstLine, segments.at(i).lineCount);
+        hashes[i] = hashLines(segmentLines.at(i));
+        for (QMultiHash<uint, Entry>::const_iterator it = cache.constFind(hashes.at(i));
+             it != cache.constEnd() && it.key() == hashes.at(i); ++it) {
+            if (it.value().lines == segmentLines.at(i)) {
+                entries[i] = &it.value();
+                break;
+            }
+        }
+        if (!entries.at(i))
+            ++changed;
+    }
+
+    // Every changed declaration costs a temporary file and a parser run of
+    // its own, so the first check and large edits such as a paste parse the
+    // whole program once and hand its diagnostics out to the declarations.
+    if (changed * 2 > segments.size())
+        return checkAll(lines, segments, segmentLines, hashes, diagnostics);
+
+    QMultiHash<uint, Entry> used;
+    int status = 0;
+    lastReparsed = 0;
+
+    for (int i = 0; i < segments.size(); ++i) {
+        const Entry *entry = entries.at(i);
+        Entry parsed;
+        if (!entry) {
+            parsed.lines = segmentLines.at(i);
+            parsed.status = CMMCheck::checkLines(parsed.lines, &parsed.diagnostics);
+            entry = &parsed;
+            ++lastReparsed;
+        }
+
+        foreach (Diagnostic diagnostic, entry->diagnostics) {
+            diagnostic.row += segments.at(i).firstLine;
+            diagnostics->append(diagnostic);
+        }
+        if (entry->status)
+            status = entry->status;
+        used.insert(hashes.at(i), *entry);
+    }
+
+    // Only declarations of the current text are worth keeping.
+    cache.swap(used);
+    return status;
+}
+
+int IncrementalCheck::checkAll(const QStringList &lines, const QVector<Segment> &segments,
+                               const QVector<QStringList> &segmentLines, const QVector<uint> &hashes,
+                               DiagnosticList *diagnostics)
+{
+    DiagnosticList all;
+    const int status = CMMCheck::checkLines(lines, &all);
+    *diagnostics += all;
+    lastReparsed = segments.size();
+
+    QVector<Entry> parsed(segments.size());
+    for (int i = 0; i < segments.size(); ++i) {
+        parsed[i].lines = segmentLines.at(i);
+        parsed[i].status = 0;
+    }
+
+    foreach (Diagnostic diagnostic, all) {
+        // Rows past the last declaration belong to it; segments are sorted.
+        int i = segments.size() - 1;
+        while (i > 0 && segments.at(i).firstLine >= diagnostic.row)
+            --i;
+        diagnostic.row -= segments.at(i).firstLine;
+        if (!diagnostic.isWarning)
+            parsed[i].status = status;
+        parsed[i].diagnostics.append(diagnostic);
+    }
+
+    QMultiHash<uint, Entry> used;
+    for (int i = 0; i < segments.size(); ++i)
+        used.insert(hashes.at(i), parsed.at(i));
+    cache.swap(used);
+    return status;
+}
@@ -0,0 +1,77 @@
+/**
+* @file  incrementalcheck.h
+* @brief Header implementing a check that only reparses changed top-level declarations.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef INCREMENTALCHECK_H
+#define INCREMENTALCHECK_H
+
+#include "cmmcheck.h"
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+// Splits the program into its top-level declarations and parses each one on
+// its own, keeping the diagnostics of every declaration keyed by its text.
+// A later check only parses declarations whose text changed and shifts the
+// cached diagnostics of the others to their new lines.
+//
+// Each changed declaration is parsed in isolation, so a declaration that
+// uses another one can get errors a full check would not report. The first
+// check, and any check where most declarations changed, parses the whole
+// program instead.
+class IncrementalCheck
+{
+public:
+    struct Segment
+    {
+        int firstLine;      // 0-based
+        int lineCount;
+    };
+
+    IncrementalCheck() : lastReparsed(0) {}
+
+    int check(const QStringList &lines, DiagnosticList *diagnostics);
+    void clear() { cache.clear(); }
+
+    // Declarations that actually went through the parser in the last check.
+    int reparsedCount() const { return lastReparsed; }
+
+    static QVector<Segment> splitTopLevel(const QStringList &lines);
+
+private:
+    struct Entry
+    {
+        QStringList lines;
+        DiagnosticList diagnostics;     // rows relative to the declaration
+        int status;
+    };
+
+    int checkAll(const QStringList &lines, const QVector<Segment> &segments,
+                 const QVector<QStringList> &segmentLines, const QVector<uint> &hashes,
+                 DiagnosticList *diagnostics);
+
+    QMultiHash<uint, Entry> cache;
+    int lastReparsed;
+};
+
+#endif // INCREMENTALCHECK_H
@@ -0,0 +1,129 @@
+/**
+* @file  livechecker.cpp
+* @brief Source implementing debounced background checking of the editor buffer.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "livechecker.h"
+#include "diagnosticscache.h"
+#include "filesaver.h"
+#include "QCodeEdit/qcodecpp.h"
+
+#include <QTextDocument>
+#include <QTimer>
+#include <QtConcurrent>
+
+namespace {
+
+const int DebounceMs = 500;
+
+} // namespace
+
+LiveChecker::LiveChecker(QTextDocument *document, QObject *parent)
+    : QObject(parent), document(document), generation(0),
+      checkedGeneration(-1), enabled(false), incremental(false)
+{
+    debounceTimer = new QTimer(this);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(DebounceMs);
+    connect(debounceTimer, SIGNAL(timeout()), this, SLOT(startCheck()));
+
+    watcher = new QFutureWatcher<Result>(this);
+    connect(watcher, SIGNAL(finished()), this, SLOT(checkFinished()));
+
+    connect(document, SIGNAL(contentsChange(int,int,int)), this, SLOT(documentChanged()));
+}
+
+void LiveChecker::setEnabled(bool on)
+{
+    enabled = on;
+    checkedGeneration = -1;
+    if (enabled)
+        scheduleCheck();
+    else
+        debounceTimer->stop();
+}
+
+void LiveChecker::setIncremental(bool on)
+{
+    incremental = on;
+    checkedGeneration = -1;
+    scheduleCheck();
+}
+
+void LiveChecker::documentChanged()
+{
+    if (QCodeCPP::isFormatting(document))
+        return;
+    ++generation;
+    scheduleCheck();
+}
+
+void LiveChecker::scheduleCheck()
+{
+    if (!enabled)
+        return;
+    debounceTimer->start();
+}
+
+void LiveChecker::startCheck()
+{
+    // A parse is still running; checkFinished() restarts once it is done.
+    if (watcher->isRunning() || checkedGeneration == generation)
+        return;
+    checkedGeneration = generation;
+
+    watcher->setFuture(QtConcurrent::run(&LiveChecker::runCheck, generation, FileSaver::snapshot(document),
+                                         incremental ? &incrementalCheck : static_cast<IncrementalCheck *>(0)));
+}
+
+LiveChecker::Result LiveChecker::runCheck(int generation, const QStringList &lines, IncrementalCheck *incrementalCheck)
+{
+    Result result;
+    result.generation = generation;
+    if (!incrementalCheck) {
+        DiagnosticsCache::instance()->check(lines, &result.diagnostics);
+        return result;
+    }
+
+    // Incremental results are pieced together from segments, so they are
+    // only read from the cache, never written to it.
+    int status;
+    if (!DiagnosticsCache::instance()->lookup(DiagnosticsCache::key(lines), &result.diagnostics, &status))
+        incrementalCheck->check(lines, &result.diagnostics);
+    return result;
+}
+
+void LiveChecker::checkFinished()
+{
+    const Result result = watcher->result();
+    if (!enabled)
+        return;
+
+    if (result.generation == generation) {
+        emit diagnosticsReady(result.diagnostics);
+        return;
+    }
+
+    // The text changed while parsing; parse again unless the debounce
+    // timer is about to.
+    if (!debounceTimer->isActive())
+        startCheck();
+}
@@ -0,0 +1,84 @@
+/**
+* @file  livechecker.h
+* @brief Header implementing debounced background checking of the editor buffer.
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef LIVECHECKER_H
+#define LIVECHECKER_H
+
+#include "cmmcheck.h"
+#include "incrementalcheck.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QTextDocument;
+class QTimer;
+QT_END_NAMESPACE
+
+// Re-checks the document a short while after the last edit. Only one parse
+// runs at a time; an edit made while it runs supersedes it, its result is
+// dropped and a fresh parse starts as soon as it is done.
+class LiveChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    LiveChecker(QTextDocument *document, QObject *parent = 0);
+
+    bool isEnabled() const { return enabled; }
+    bool isIncremental() const { return incremental; }
+
+public slots:
+    void setEnabled(bool on);
+    void setIncremental(bool on);
+    void scheduleCheck();
+
+signals:
+    void diagnosticsReady(const DiagnosticList &diagnostics);
+
+private slots:
+    void documentChanged();
+    void startCheck();
+    void checkFinished();
+
+private:
+    struct Result
+    {
+        int generation;
+        DiagnosticList diagnostics;
+    };
+
+    static Result runCheck(int generation, const QStringList &lines, IncrementalCheck *incrementalCheck);
+
+    QTextDocument *document;
+    QTimer *debounceTimer;
+    QFutureWatcher<Result> *watcher;
+    IncrementalCheck incrementalCheck;
+    int generation;             // counts text changes
+    int checkedGeneration;      // -1 forces the next check
+    bool enabled;
+    bool incremental;
+};
+
+#endif // LIVECHECKER_H
@@ -22,12 +22,52 @@
 **/
 
 #include "mainwindow.h"
+#include "batchcheck.h"
+#ifdef Q_OS_UNIX
+#include "runserver.h"
+#endif
 
 #include <QApplication>
 
+#include <cstring>
+
+// Index of the argument, or 0 when it is not given.
+static int argumentIndex(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], name) == 0)
+            return i;
+    }
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+#ifdef Q_OS_UNIX
+    // The warm interpreter server started by RunClient; it never needs a GUI.
+    const int serverIndex = argumentIndex(argc, argv, "--run-server");
+    if (serverIndex && serverIndex + 1 < argc) {
+        QCoreApplication app(argc, argv);
+        RunServer server;
+        if (!server.listen(QString::fromLocal8Bit(argv[serverIndex + 1])))
+            return 2;
+        return app.exec();
+    }
+#endif
+
+    // Batch checks need no application object at all, which keeps start-up
+    // down to loading the binary.
+    if (argumentIndex(argc, argv, "--check")) {
+        QStringList arguments;
+        for (int i = 0; i < argc; ++i)
+            arguments << QString::fromLocal8Bit(argv[i]);
+        return BatchCheck::run(arguments);
+    }
+
     QApplication app(argc, argv);
+    app.setOrganizationName("QCodeEdit");
+    app.setApplicationName("CMM Editor");
+
     MainWindow window;
     window.resize(640, 512);
     window.show();
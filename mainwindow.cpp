@@ -21,12 +21,25 @@
 * along with this program. If not, see <http://www.gnu.org/licenses/>.
 **/
 #include <QtWidgets>
-#include <QTableWidget>
 #include <iostream>
+#include <climits>
 
 #include "mainwindow.h"
-#include "SourceMgr.h"
-#include "CMMParser.h"
+#include "fileloader.h"
+#include "filesaver.h"
+#include "findbar.h"
+#include "cmmcheck.h"
+#include "diagnosticscache.h"
+#include "diagnosticsmodel.h"
+#include "livechecker.h"
+#include "outputconsole.h"
+#include "projectchecker.h"
+#include "programrunner.h"
+#ifdef Q_OS_UNIX
+#include "runclient.h"
+#endif
+#include "QCodeEdit/qcodeprofiler.h"
+#include "QCodeEdit/qcodeundo.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -35,11 +48,17 @@ MainWindow::MainWindow(QWidget *parent)
     setupHelpMenu();
     setupSettingMenu();
     setupEditor();
+    setupEditMenu();
     setupTable();
+    setupOutputDock();
+    setupTabs();
 
     QVBoxLayout *mainLayout = new QVBoxLayout;
+    mainLayout->setSpacing(0);
+    mainLayout->addWidget(tabBar);
     mainLayout->addWidget(editor, 3);
-    mainLayout->addWidget(errorTable, 1);
+    mainLayout->addWidget(findBar);
+    mainLayout->addWidget(diagnosticsPane, 1);
 
     QWidget *widget = new QWidget;
     widget->setLayout(mainLayout);
@@ -47,10 +66,25 @@ MainWindow::MainWindow(QWidget *parent)
 
     setWindowTitle(tr("CMM Editor - "));
 
+    loadProgressBar = new QProgressBar;
+    loadProgressBar->setMaximumWidth(200);
+    loadProgressBar->setRange(0, 1000);
+    loadProgressBar->hide();
+    statusBar()->addPermanentWidget(loadProgressBar);
+
+#ifdef QCODEEDIT_PROFILING
+    profilerLabel = new QLabel;
+    profilerLabel->hide();
+    statusBar()->addWidget(profilerLabel, 1);
+    profilerTimer = new QTimer(this);
+    profilerTimer->setInterval(1000);
+    connect(profilerTimer, SIGNAL(timeout()), this, SLOT(updateProfilerOverlay()));
+#endif
+
 //    QString appPath = qApp->applicationDirPath();
 //    editor->setPlainText(appPath);
 
-    connect(errorTable, SIGNAL(itemDoubleClicked(QTableWidgetItem *)), this, SLOT(jumpToBug(QTableWidgetItem *)));
+    connect(errorTable, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(jumpToBug(QModelIndex)));
     connect(editor, SIGNAL(textChanged()), this, SLOT(changeState()));
 }
 
@@ -66,129 +100,689 @@ void MainWindow::about()
 
 void MainWindow::newFile()
 {
-    if (!fileIsSaved) {
-        QMessageBox::warning(NULL, QString("Warning"), QString("Please save current file before opening another file!"), QMessageBox::Ok);
-    } else {
-        editor->clear();
-        currentFileName = "";
-        //setupTable();
-        fileIsSaved = false;
-    }
+    tabBar->setCurrentIndex(addTab(QString()));
 }
 
 void MainWindow::openFile(const QString &path)
 {
-    QString fileName = path;
+    QStringList fileNames;
+    if (path.isNull())
+        fileNames = QFileDialog::getOpenFileNames(this, tr("Open File"), "", "Cmm Files (*.cmm)");
+    else if (!path.isEmpty())
+        fileNames << path;
 
-    if (fileName.isNull()) {
-        fileName = QFileDialog::getOpenFileName(this, tr("Open File"), "", "Cmm Files (*.cmm)");
+    // Only the tab that ends up current reads its file now.
+    int index = -1;
+    for (const QString &fileName : fileNames) {
+        index = findTab(fileName);
+        if (index < 0)
+            index = addTab(fileName);
     }
+    if (index >= 0)
+        tabBar->setCurrentIndex(index);
+}
 
-    if (!fileName.isEmpty()) {
-        QFile file(fileName);
-        if (file.open(QFile::ReadOnly | QFile::Text)) {
-            editor->setPlainText(file.readAll());
-        }
-        currentFileName = fileName;
-        //setupTable();
+void MainWindow::startLoading(const QString &fileName)
+{
+    cancelLoading();
+    pendingJumpRow = 0;
+    editor->clear();
+    editor->undoStack()->setEnabled(false);
+
+    // The file streams in from a worker thread; the first screen is
+    // editable as soon as the first chunk has been appended.
+    loader = new FileLoader(fileName, this);
+    connect(loader, SIGNAL(chunkRead(QString)), this, SLOT(appendLoadedChunk(QString)));
+    connect(loader, SIGNAL(progress(qint64,qint64)), this, SLOT(updateLoadProgress(qint64,qint64)));
+    connect(loader, SIGNAL(loaded()), this, SLOT(loadFinished()));
+    connect(loader, SIGNAL(failed(QString)), this, SLOT(loadFailed(QString)));
+    loadProgressBar->setValue(0);
+    loadProgressBar->show();
+    QCODE_PROBE_BEGIN(openSpan, "open");
+    loader->start();
+}
+
+void MainWindow::setupTabs()
+{
+    tabBar = new QTabBar;
+    tabBar->setTabsClosable(true);
+    tabBar->setMovable(true);
+    tabBar->setExpanding(false);
+    tabBar->setDocumentMode(true);
+
+    // The editor already holds the first document.
+    DocumentTab tab;
+    tab.fileName = currentFileName;
+    tab.onDisk = false;
+    tab.saved = fileIsSaved;
+    tab.cursorPosition = 0;
+    tab.scrollPosition = 0;
+    tabs.append(tab);
+    activeTab = tabBar->addTab(QString());
+    updateTabTitle();
+
+    connect(tabBar, SIGNAL(currentChanged(int)), this, SLOT(switchTab(int)));
+    connect(tabBar, SIGNAL(tabMoved(int,int)), this, SLOT(moveTab(int,int)));
+    connect(tabBar, SIGNAL(tabCloseRequested(int)), this, SLOT(closeTab(int)));
+}
+
+int MainWindow::addTab(const QString &fileName)
+{
+    DocumentTab tab;
+    tab.fileName = fileName;
+    tab.onDisk = !fileName.isEmpty();
+    tab.saved = tab.onDisk;
+    tab.cursorPosition = 0;
+    tab.scrollPosition = 0;
+    tabs.append(tab);
+
+    const int index = tabBar->addTab(fileName.isEmpty() ? tr("untitled") : QFileInfo(fileName).fileName());
+    tabBar->setTabToolTip(index, fileName);
+    return index;
+}
+
+int MainWindow::findTab(const QString &fileName) const
+{
+    const QString path = QFileInfo(fileName).absoluteFilePath();
+    for (int i = 0; i < tabs.size(); i++) {
+        if (!tabs.at(i).fileName.isEmpty() && QFileInfo(tabs.at(i).fileName).absoluteFilePath() == path)
+            return i;
     }
-    fileIsSaved = true;
+    return -1;
 }
 
-void MainWindow::saveFile()
+void MainWindow::switchTab(int index)
 {
-    if (currentFileName != "") {
-        QFile file(currentFileName);
-        file.open(QIODevice::WriteOnly);
-        QTextStream out(&file);
-        out << editor -> toPlainText();
-        file.close();
+    if (index == activeTab)
+        return;
+    if (loader && !fileIsSaved && index >= 0) {
+        // Edited while loading: the edits are stashed together with the
+        // rest of the file, so the switch waits for loadFinished().
+        deferredTab = index;
+        tabBar->blockSignals(true);
+        tabBar->setCurrentIndex(activeTab);
+        tabBar->blockSignals(false);
+        statusBar()->showMessage(tr("Switching tabs once the file has finished loading..."));
+        return;
+    }
+    if (activeTab >= 0)
+        stashTab(activeTab);
+    if (index >= 0)
+        activateTab(index);
+}
+
+void MainWindow::stashTab(int index)
+{
+    DocumentTab &tab = tabs[index];
+    if (loader && fileIsSaved) {
+        // Read again from the start when the tab comes back.
+        cancelLoading();
+        tab.onDisk = true;
+        tab.saved = true;
+        return;
+    }
+    tab.text = editor->toPlainText().toUtf8();
+    tab.saved = fileIsSaved;
+    tab.cursorPosition = editor->textCursor().position();
+    tab.scrollPosition = editor->verticalScrollBar()->value();
+}
+
+void MainWindow::activateTab(int index)
+{
+    DocumentTab &tab = tabs[index];
+    activeTab = index;
+    currentFileName = tab.fileName;
+    showDiagnostics(DiagnosticList());
+
+    if (tab.onDisk) {
+        tab.onDisk = false;
+        startLoading(tab.fileName);
         fileIsSaved = true;
-    } else {
-        QString fileName = QFileDialog::getSaveFileName(this, tr("Save File"),
+        updateTabTitle();
+        return;
+    }
+
+    editor->setPlainText(QString::fromUtf8(tab.text));
+    editor->undoStack()->clear();
+    tab.text = QByteArray();
+    fileIsSaved = tab.saved;
+
+    QTextCursor cursor(editor->document());
+    cursor.setPosition(qBound(0, tab.cursorPosition, editor->document()->characterCount() - 1));
+    editor->setTextCursor(cursor);
+    editor->verticalScrollBar()->setValue(tab.scrollPosition);
+    updateTabTitle();
+    showCachedDiagnostics();
+}
+
+void MainWindow::switchToDeferredTab()
+{
+    const int index = deferredTab;
+    deferredTab = -1;
+    if (index >= 0 && index < tabs.size())
+        tabBar->setCurrentIndex(index);
+}
+
+void MainWindow::moveTab(int from, int to)
+{
+    if (deferredTab == from)
+        deferredTab = to;
+    else if (from < deferredTab && deferredTab <= to)
+        --deferredTab;
+    else if (to <= deferredTab && deferredTab < from)
+        ++deferredTab;
+    tabs.move(from, to);
+    activeTab = tabBar->currentIndex();
+}
+
+void MainWindow::closeTab(int index)
+{
+    const bool active = index == activeTab;
+    if (!isTabSaved(index) && QMessageBox::question(this, tr("Close Tab"),
+                                        tr("Discard the changes to %1?").arg(tabBar->tabText(index)))
+            != QMessageBox::Yes)
+        return;
+
+    if (active) {
+        cancelLoading();
+        activeTab = -1;
+        deferredTab = -1;
+    } else if (index < activeTab) {
+        --activeTab;
+    }
+    if (index == deferredTab)
+        deferredTab = -1;
+    else if (index < deferredTab)
+        --deferredTab;
+    tabs.remove(index);
+    tabBar->removeTab(index);
+    if (tabs.isEmpty())
+        newFile();
+}
+
+bool MainWindow::isTabSaved(int index) const
+{
+    if (index == activeTab)
+        return fileIsSaved || editor->document()->isEmpty();
+    const DocumentTab &tab = tabs.at(index);
+    return tab.saved || (!tab.onDisk && tab.text.isEmpty());
+}
+
+void MainWindow::closeCurrentTab()
+{
+    closeTab(activeTab);
+}
+
+void MainWindow::updateTabTitle()
+{
+    if (activeTab < 0)
+        return;
+    const QString name = currentFileName.isEmpty() ? tr("untitled") : QFileInfo(currentFileName).fileName();
+    tabBar->setTabText(activeTab, fileIsSaved ? name : name + "*");
+    tabBar->setTabToolTip(activeTab, currentFileName);
+    tabs[activeTab].fileName = currentFileName;
+}
+
+void MainWindow::appendLoadedChunk(const QString &text)
+{
+    if (sender() != loader)
+        return;
+
+    QTextCursor cursor(editor->document());
+    cursor.movePosition(QTextCursor::End);
+    appendingChunk = true;
+    cursor.insertText(text);
+    appendingChunk = false;
+    loader->chunkConsumed();
+}
+
+void MainWindow::updateLoadProgress(qint64 bytesRead, qint64 bytesTotal)
+{
+    if (sender() == loader && bytesTotal > 0)
+        loadProgressBar->setValue(int(bytesRead * 1000 / bytesTotal));
+}
+
+void MainWindow::loadFinished()
+{
+    if (sender() != loader)
+        return;
+    QCODE_PROBE_END(openSpan);
+    cancelLoading();
+    updateTabTitle();
+    showCachedDiagnostics();
+    if (pendingJumpRow > 0) {
+        goToLocation(pendingJumpRow, pendingJumpCol);
+        pendingJumpRow = 0;
+    }
+    switchToDeferredTab();
+}
+
+void MainWindow::showCachedDiagnostics()
+{
+    // A file checked before shows its diagnostics straight away.
+    DiagnosticList diagnostics;
+    int status;
+    const quint64 key = DiagnosticsCache::key(FileSaver::snapshot(editor->document()));
+    if (DiagnosticsCache::instance()->lookup(key, &diagnostics, &status))
+        showDiagnostics(diagnostics);
+}
+
+void MainWindow::loadFailed(const QString &message)
+{
+    if (sender() != loader)
+        return;
+    QCODE_PROBE_END(openSpan);
+    cancelLoading();
+    QMessageBox::warning(this, tr("Open File"), tr("Could not read %1:\n%2").arg(currentFileName, message));
+    switchToDeferredTab();
+}
+
+void MainWindow::cancelLoading()
+{
+    if (loader) {
+        loader->cancel();
+        loader->deleteLater();
+        loader = nullptr;
+        editor->undoStack()->setEnabled(true);
+    }
+    loadProgressBar->hide();
+}
+
+void MainWindow::saveFile()
+{
+    if (loader) {
+        QMessageBox::warning(NULL, QString("Warning"), QString("Please wait until the file has finished loading!"), QMessageBox::Ok);
+        return;
+    }
+    QString fileName = currentFileName;
+    if (fileName.isEmpty()) {
+        fileName = QFileDialog::getSaveFileName(this, tr("Save File"),
                                 QDir::currentPath(),
                                 tr("Cmm Files (*.cmm)"));
-        if (!fileName.isNull()) {
-            QFile file(fileName);
-            file.open(QIODevice::WriteOnly);
-            QTextStream out(&file);
-            out << editor->toPlainText();
-            file.close();
-            currentFileName = fileName;
-            fileIsSaved = true;
-        }
+        if (fileName.isNull())
+            return;
+        currentFileName = fileName;
     }
+
+    if (saver) {
+        // Picked up by finishSave() once the running save is done.
+        queuedSave = fileName;
+        updateTabTitle();
+        return;
+    }
+
+    saver = new FileSaver(fileName, editor->document(), this);
+    connect(saver, SIGNAL(saved()), this, SLOT(saveFinished()));
+    connect(saver, SIGNAL(failed(QString)), this, SLOT(saveFailed(QString)));
+    QCODE_PROBE_BEGIN(saveSpan, "save");
+    saver->start();
+    statusBar()->showMessage(tr("Saving %1...").arg(fileName));
+    fileIsSaved = true;
+    updateTabTitle();
 }
 
-bool MainWindow::FileHasError()
+void MainWindow::saveFinished()
 {
-    using namespace cmm;
-    using namespace std;
+    statusBar()->showMessage(tr("Saved %1").arg(saver->fileName()), 2000);
+    finishSave();
+}
 
-    SourceMgr SrcMgr(this->currentFileName.toStdString(), false);
-    //if (SrcMgr.fail()) {
-    //    cerr << "I'm sure SrcMgr is started, and file = " << currentFileName.toStdString() << "\n";
-    //    return true;
-    //}
+void MainWindow::saveFailed(const QString &message)
+{
+    statusBar()->clearMessage();
+    QMessageBox::warning(this, tr("Save File"), tr("Could not save %1:\n%2").arg(saver->fileName(), message));
 
-    CMMParser Parser(SrcMgr);
+    // The tab that was saved may no longer be the current one.
+    const int index = findTab(saver->fileName());
+    if (index == activeTab) {
+        fileIsSaved = false;
+        updateTabTitle();
+    } else if (index >= 0) {
+        tabs[index].saved = false;
+        if (!tabBar->tabText(index).endsWith('*'))
+            tabBar->setTabText(index, tabBar->tabText(index) + "*");
+    }
+    finishSave();
+}
 
-    int Err = Parser.parse();
+void MainWindow::finishSave()
+{
+    saver->wait();
+    QCODE_PROBE_END(saveSpan);
+    saver->deleteLater();
+    saver = nullptr;
 
-    cerr << "I'm sure this is started, and Err = " << Err << endl;
-    for (SourceMgr::ErrorTy &Msg : SrcMgr.getErrorList()) {
-        SourceMgr::LocTy ErrLoc = std::get<0>(Msg);
-        bool isWarning = std::get<1>(Msg) == SourceMgr::ErrorKind::Warning;
-        std::pair<size_t,size_t> RowCol = SrcMgr.getLineColByLoc(ErrLoc);
-        std::string &M = std::get<2>(Msg);
+    // A queued save is only redone for the document it was asked for; a
+    // tab switched away from meanwhile stays marked modified.
+    const QString fileName = queuedSave;
+    queuedSave.clear();
+    if (!fileName.isEmpty() && findTab(fileName) == activeTab)
+        saveFile();
+}
 
-        std::cout << "Taburu: " << "iswarning:" << isWarning << "(" << RowCol.first<<","<<RowCol.second <<")"<< M << std::endl;
+void MainWindow::closeEvent(QCloseEvent *event)
+{
+    // Let a running save, and one queued behind it, land before quitting.
+    // Its result is delivered right away so a failure is still reported.
+    while (saver) {
+        saver->wait();
+        QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+    }
 
-        this->insertToTable(isWarning, RowCol.first + 1, RowCol.second + 1, M);
+    QStringList unsaved;
+    for (int i = 0; i < tabs.size(); i++) {
+        if (!isTabSaved(i))
+            unsaved << tabBar->tabText(i);
+    }
+    if (!unsaved.isEmpty() && QMessageBox::question(this, tr("Exit"),
+                                                    tr("Discard the changes to %1?").arg(unsaved.join(", ")))
+            != QMessageBox::Yes) {
+        event->ignore();
+        return;
     }
+    event->accept();
+}
+
+bool MainWindow::FileHasError()
+{
+    QCODE_PROBE("FileHasError");
+    DiagnosticList diagnostics;
+    int Err = DiagnosticsCache::instance()->check(FileSaver::snapshot(editor->document()), &diagnostics);
+    diagnosticsModel->clear();
+    showDiagnostics(diagnostics);
     return Err;
 }
 
+void MainWindow::showDiagnostics(const DiagnosticList &diagnostics)
+{
+    // Project results stay in the table until the next explicit check;
+    // the buffer's own diagnostics then only go to the editor.
+    if (!diagnosticsModel->hasFiles()) {
+        diagnosticsModel->setDiagnostics(diagnostics);
+        errorTable->setColumnHidden(DiagnosticsModel::FileColumn, true);
+    }
+
+    // Underline the word each diagnostic points at.
+    QTextDocument *doc = editor->document();
+    QCodeEdit::LayerRangeList ranges;
+    ranges.reserve(diagnostics.size());
+    for (const Diagnostic &diagnostic : diagnostics) {
+        const QTextBlock block = doc->findBlockByNumber(diagnostic.row - 1);
+        if (!block.isValid())
+            continue;
+        const QString text = block.text();
+        const int start = qBound(0, diagnostic.col - 1, text.length());
+        int end = start;
+        while (end < text.length() && (text.at(end).isLetterOrNumber() || text.at(end) == QLatin1Char('_')))
+            ++end;
+
+        QCodeEdit::LayerRange range;
+        range.position = block.position() + start;
+        range.length = qMax(1, end - start);
+        range.color = diagnostic.isWarning ? QColor::fromRgb(255,160,0) : QColor(Qt::red);
+        ranges.append(range);
+    }
+    editor->setLayerRanges(QCodeEdit::DiagnosticLayer, ranges);
+}
+
+void MainWindow::checkFile()
+{
+    FileHasError();
+}
+
+void MainWindow::checkProject()
+{
+    const QString start = currentFileName.isEmpty() ? QDir::currentPath() : QFileInfo(currentFileName).absolutePath();
+    const QString directory = QFileDialog::getExistingDirectory(this, tr("Check Project"), start);
+    if (directory.isEmpty())
+        return;
+    projectChecker->start(directory);
+    statusBar()->showMessage(tr("Looking for CMM files in %1...").arg(directory));
+}
+
+void MainWindow::projectCheckStarted(int fileCount)
+{
+    diagnosticsModel->clear();
+    statusBar()->showMessage(tr("Checking %n file(s)...", 0, fileCount));
+}
+
+void MainWindow::projectFilesChecked(const FileCheckList &files)
+{
+    diagnosticsModel->appendDiagnostics(files);
+    errorTable->setColumnHidden(DiagnosticsModel::FileColumn, false);
+}
+
+void MainWindow::projectCheckProgress(int checked, int total)
+{
+    statusBar()->showMessage(tr("Checked %1 of %2 files").arg(checked).arg(total));
+}
+
+void MainWindow::projectCheckFinished(int fileCount, int failedCount, qint64 elapsedMs)
+{
+    statusBar()->showMessage(tr("Checked %1 files in %2 s, %3 with errors")
+                             .arg(fileCount).arg(elapsedMs / 1000.0, 0, 'f', 1).arg(failedCount));
+}
+
 void MainWindow::compileFile()
 {
-    if (!fileIsSaved) {
-        QMessageBox::warning(NULL, QString("Warning"), QString("Please save before compiling!"), QMessageBox::Ok);
+    if (FileHasError())
+        return;
+
+    if (isProgramRunning()) {
+        statusBar()->showMessage(tr("A program is still running"), 2000);
+    } else if (runClient && warmRun) {
+        // The run server is sent the buffer itself, so nothing needs saving.
+        showOutputPane();
+        runClient->start(interpreterPath(), currentFileName, editor->toPlainText(),
+                         ProgramRunner::splitArguments(arguments));
+    } else if (!fileIsSaved || saver) {
+        QMessageBox::warning(NULL, QString("Warning"), QString("Please save before running!"), QMessageBox::Ok);
     } else {
-        //setupTable();
-        errorTable->clearContents();
-        if (FileHasError())
-           return;
-        QProcess p;
-        QString cmd = QString("osascript");
-        QStringList args;
-        //QString TerminalCmd = "ls";
-        QString TerminalCmd = "/Users/wang/Documents/Codes/Cpp/CMM/cmake-build-debug/cmm ";
-        TerminalCmd += currentFileName + " " + arguments;
-        QString ascript = "tell application \"Terminal\"\n";
-        ascript += "  activate\n";
-        ascript += "  do script \"";
-        ascript += TerminalCmd;
-        ascript += "\"\n";
-        ascript += "end tell";
-        args << "-e" << ascript;
-        p.startDetached(cmd, args);
+        showOutputPane();
+        runner->start(interpreterPath(), currentFileName, ProgramRunner::splitArguments(arguments));
+    }
+}
+
+bool MainWindow::isProgramRunning() const
+{
+    return runner->isRunning() || (runClient && runClient->isRunning());
+}
+
+void MainWindow::showOutputPane()
+{
+    outputConsole->clear();
+    outputDock->show();
+    outputDock->raise();
+    const QString name = currentFileName.isEmpty() ? tr("untitled") : QFileInfo(currentFileName).fileName();
+    runStatus->setText(tr("Running %1...").arg(name));
+}
+
+void MainWindow::setWarmRun(bool enabled)
+{
+    warmRun = enabled;
+    QSettings().setValue("run/warm", enabled);
+}
+
+void MainWindow::setUndoBudget()
+{
+    bool ok;
+    const int megabytes = QInputDialog::getInt(this, tr("Undo Memory"),
+                                               tr("Memory for undo history (MB); older steps go to a temporary file:"),
+                                               QSettings().value("edit/undoBudgetMB", 32).toInt(), 1, 4096, 1, &ok);
+    if (ok) {
+        QSettings().setValue("edit/undoBudgetMB", megabytes);
+        editor->undoStack()->setMemoryBudget(qint64(megabytes) * 1024 * 1024);
+    }
+}
+
+void MainWindow::setDiskCache(bool enabled)
+{
+    DiagnosticsCache::instance()->setDiskEnabled(enabled);
+    QSettings().setValue("check/diskCache", enabled);
+}
+
+QString MainWindow::interpreterPath() const
+{
+    return QSettings().value("run/interpreter", "cmm").toString();
+}
+
+void MainWindow::setInterpreter()
+{
+    const QString path = QFileDialog::getOpenFileName(this, tr("CMM Interpreter"), interpreterPath());
+    if (!path.isEmpty())
+        QSettings().setValue("run/interpreter", path);
+}
+
+void MainWindow::appendOutput(const QString &text, bool isError)
+{
+    outputConsole->append(text, isError);
+}
+
+void MainWindow::saveOutput()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Save Output"), "output.log",
+                                                          tr("Log files (*.log *.txt)"));
+    if (fileName.isEmpty())
+        return;
+    QString error;
+    if (!outputConsole->saveOutput(fileName, &error))
+        QMessageBox::warning(this, tr("Save Output"), tr("Could not save %1:\n%2").arg(fileName, error));
+}
+
+void MainWindow::sendInput()
+{
+    const QString line = inputLine->text() + '\n';
+    inputLine->clear();
+    appendOutput(line, false);
+    runner->writeInput(line);
+    if (runClient)
+        runClient->writeInput(line);
+}
+
+void MainWindow::runFinished(const ProgramRunner::Result &result)
+{
+    QString summary;
+    if (result.cancelled)
+        summary = tr("Cancelled");
+    else if (result.crashed)
+        summary = tr("Crashed");
+    else
+        summary = tr("Exit code %1").arg(result.exitCode);
+    summary += tr(", %1 s").arg(result.wallMs / 1000.0, 0, 'f', 2);
+    if (result.peakRssKb >= 0)
+        summary += tr(", peak RSS %1 MB").arg(result.peakRssKb / 1024.0, 0, 'f', 1);
+    runStatus->setText(summary);
+}
+
+void MainWindow::stopProgram()
+{
+    runner->cancel();
+    if (runClient)
+        runClient->cancel();
+}
+
+void MainWindow::runFailed(const QString &message)
+{
+    runStatus->setText(tr("Could not start %1: %2").arg(interpreterPath(), message));
+}
+
+void MainWindow::setupOutputDock()
+{
+    runner = new ProgramRunner(this);
+    connect(runner, SIGNAL(output(QString,bool)), this, SLOT(appendOutput(QString,bool)));
+    connect(runner, SIGNAL(finished(ProgramRunner::Result)), this, SLOT(runFinished(ProgramRunner::Result)));
+    connect(runner, SIGNAL(failed(QString)), this, SLOT(runFailed(QString)));
+
+    runClient = nullptr;
+    warmRun = QSettings().value("run/warm", false).toBool();
+#ifdef Q_OS_UNIX
+    runClient = new RunClient(this);
+    connect(runClient, SIGNAL(output(QString,bool)), this, SLOT(appendOutput(QString,bool)));
+    connect(runClient, SIGNAL(finished(ProgramRunner::Result)), this, SLOT(runFinished(ProgramRunner::Result)));
+    connect(runClient, SIGNAL(failed(QString)), this, SLOT(runFailed(QString)));
+#endif
+
+    outputConsole = new OutputConsole;
+
+    QCheckBox *spillBox = new QCheckBox(tr("Keep full output"));
+    spillBox->setToolTip(tr("Write all output to a temporary file, so Save Output has every line"));
+    connect(spillBox, SIGNAL(toggled(bool)), outputConsole, SLOT(setSpillEnabled(bool)));
+
+    QPushButton *saveOutputButton = new QPushButton(tr("Save Output..."));
+    connect(saveOutputButton, SIGNAL(clicked()), this, SLOT(saveOutput()));
+
+    inputLine = new QLineEdit;
+    inputLine->setPlaceholderText(tr("Program input"));
+    connect(inputLine, SIGNAL(returnPressed()), this, SLOT(sendInput()));
+
+    QPushButton *stopButton = new QPushButton(tr("Stop"));
+    connect(stopButton, SIGNAL(clicked()), this, SLOT(stopProgram()));
+
+    runStatus = new QLabel;
+
+    QHBoxLayout *controls = new QHBoxLayout;
+    controls->setContentsMargins(0, 0, 0, 0);
+    controls->addWidget(inputLine, 1);
+    controls->addWidget(stopButton);
+    controls->addWidget(spillBox);
+    controls->addWidget(saveOutputButton);
+    controls->addWidget(runStatus);
+
+    QVBoxLayout *layout = new QVBoxLayout;
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(outputConsole);
+    layout->addLayout(controls);
+
+    QWidget *pane = new QWidget;
+    pane->setLayout(layout);
+
+    outputDock = new QDockWidget(tr("Output"), this);
+    outputDock->setObjectName("outputDock");
+    outputDock->setWidget(pane);
+    addDockWidget(Qt::BottomDockWidgetArea, outputDock);
+    outputDock->hide();
+}
+
+void MainWindow::jumpToBug(const QModelIndex &index){
+    int bugRow = diagnosticsModel->line(index.row());
+    int bugCol = diagnosticsModel->column(index.row());
+
+    // A project result may be in another file; one still streaming in is
+    // jumped into once it has loaded.
+    const QString fileName = diagnosticsModel->fileName(index.row());
+    if (!fileName.isEmpty() && findTab(fileName) != activeTab) {
+        openFile(fileName);
+        if (loader) {
+            pendingJumpRow = bugRow;
+            pendingJumpCol = bugCol;
+            return;
+        }
     }
+    goToLocation(bugRow, bugCol);
 }
 
-void MainWindow::jumpToBug(QTableWidgetItem *item){
-    int tableRow = item->row();
-    int bugRow = errorTable->item(tableRow, 0)->text().toInt();
-    int bugCol = errorTable->item(tableRow, 1)->text().toInt();
-    QTextCursor qtc = editor->textCursor();
-    qtc.setPosition(0);
-    qtc.movePosition(QTextCursor::NextBlock, QTextCursor::MoveAnchor, bugRow-1);
-    qtc.movePosition(QTextCursor::NextCharacter, QTextCursor::MoveAnchor, bugCol-1);
+void MainWindow::goToLocation(int row, int col)
+{
+    // findBlockByNumber is a tree lookup, so this costs the same on line 10 and line 900,000.
+    QTextBlock block = editor->document()->findBlockByNumber(qMax(0, row - 1));
+    if (!block.isValid())
+        block = editor->document()->lastBlock();
+    QTextCursor qtc(block);
+    qtc.setPosition(block.position() + qBound(0, col - 1, block.length() - 1));
     editor->setFocus();
     editor->setTextCursor(qtc);
+    editor->centerCursor();
 }
 
 void MainWindow::changeState() {
-    fileIsSaved = false;
+    // Text streamed in by the loader is the file itself, only edits typed
+    // while it loads make the document modified.
+    if (appendingChunk)
+        return;
+    if (fileIsSaved) {
+        fileIsSaved = false;
+        updateTabTitle();
+    }
 }
 
 void MainWindow::setupEditor()
@@ -201,7 +795,13 @@ void MainWindow::setupEditor()
     editor = new QCodeEdit();
     editor->setFont(font);
 
+    editor->undoStack()->setMemoryBudget(qint64(QSettings().value("edit/undoBudgetMB", 32).toInt()) * 1024 * 1024);
+
     highlighter = new QCodeCPP(editor->document());
+    connect(editor, SIGNAL(visibleBlocksChanged(int,int)), highlighter, SLOT(setVisibleBlocks(int,int)));
+
+    liveChecker = new LiveChecker(editor->document(), this);
+    connect(liveChecker, SIGNAL(diagnosticsReady(DiagnosticList)), this, SLOT(showDiagnostics(DiagnosticList)));
 
     QFile file("mainwindow.h");
     if (file.open(QFile::ReadOnly | QFile::Text))
@@ -210,28 +810,69 @@ void MainWindow::setupEditor()
 
 void MainWindow::setupTable()
 {
-    errorTable = new QTableWidget(0, 3);
-    errorTable->setHorizontalHeaderLabels(QStringList()<<"Row"<<"Column"<<"Information");
+    diagnosticsModel = new DiagnosticsModel(this);
+
+    projectChecker = new ProjectChecker(this);
+    connect(projectChecker, SIGNAL(started(int)), this, SLOT(projectCheckStarted(int)));
+    connect(projectChecker, SIGNAL(filesChecked(FileCheckList)), this, SLOT(projectFilesChecked(FileCheckList)));
+    connect(projectChecker, SIGNAL(progress(int,int)), this, SLOT(projectCheckProgress(int,int)));
+    connect(projectChecker, SIGNAL(finished(int,int,qint64)), this, SLOT(projectCheckFinished(int,int,qint64)));
+
+    errorTable = new QTableView;
+    errorTable->setModel(diagnosticsModel);
+    errorTable->setSortingEnabled(true);
+    errorTable->sortByColumn(DiagnosticsModel::RowColumn, Qt::AscendingOrder);
+    errorTable->setColumnHidden(DiagnosticsModel::FileColumn, true);
+    errorTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     QHeaderView* header = errorTable->horizontalHeader();
     header->setStretchLastSection(true);
 
-//    errorTable->setItem(0, 0, new QTableWidgetItem(tr("1")));
-//    errorTable->setItem(0, 1, new QTableWidgetItem(tr("2")));
-//    errorTable->setItem(0, 2, new QTableWidgetItem(tr("e1")));
-//    errorTable->setItem(1, 0, new QTableWidgetItem(tr("2")));
-//    errorTable->setItem(1, 1, new QTableWidgetItem(tr("4")));
-//    errorTable->setItem(1, 2, new QTableWidgetItem(tr("e2")));
-//    errorTable->setItem(2, 0, new QTableWidgetItem(tr("5")));
-//    errorTable->setItem(2, 1, new QTableWidgetItem(tr("2")));
-//    errorTable->setItem(2, 2, new QTableWidgetItem(tr("e3")));
-
-//    for (int i = 0; i < 3; i++) {
-//        for (int j = 0; j < 2; j++) {
-//            errorTable->item(i,j)->setFlags(errorTable->item(i,j)->flags() ^ Qt::ItemIsEditable);
-//            errorTable->item(i,j)->setBackground(QColor::fromRgb(238,99,99));
-//        }
-//        errorTable->item(i,2)->setFlags(errorTable->item(i,2)->flags() ^ Qt::ItemIsEditable);
-//    }
+    severityFilter = new QComboBox;
+    severityFilter->addItem(tr("Errors and warnings"), int(DiagnosticsModel::AllSeverities));
+    severityFilter->addItem(tr("Errors only"), int(DiagnosticsModel::Errors));
+    severityFilter->addItem(tr("Warnings only"), int(DiagnosticsModel::Warnings));
+    connect(severityFilter, SIGNAL(currentIndexChanged(int)), this, SLOT(filterDiagnostics()));
+
+    lineFilter = new QLineEdit;
+    lineFilter->setPlaceholderText(tr("Lines, e.g. 10-200"));
+    connect(lineFilter, SIGNAL(editingFinished()), this, SLOT(filterDiagnostics()));
+
+    QHBoxLayout *filterLayout = new QHBoxLayout;
+    filterLayout->setContentsMargins(0, 0, 0, 0);
+    filterLayout->addWidget(severityFilter);
+    filterLayout->addWidget(lineFilter);
+    filterLayout->addStretch();
+
+    QVBoxLayout *paneLayout = new QVBoxLayout;
+    paneLayout->setContentsMargins(0, 0, 0, 0);
+    paneLayout->addLayout(filterLayout);
+    paneLayout->addWidget(errorTable);
+
+    diagnosticsPane = new QWidget;
+    diagnosticsPane->setLayout(paneLayout);
+}
+
+void MainWindow::filterDiagnostics()
+{
+    diagnosticsModel->setSeverityFilter(severityFilter->currentData().toInt());
+
+    int firstLine = 0;
+    int lastLine = INT_MAX;
+    const QString range = lineFilter->text().trimmed();
+    if (!range.isEmpty()) {
+        const int dash = range.indexOf('-');
+        if (dash < 0) {
+            firstLine = lastLine = range.toInt();
+        } else {
+            const QString from = range.left(dash).trimmed();
+            const QString to = range.mid(dash + 1).trimmed();
+            if (!from.isEmpty())
+                firstLine = from.toInt();
+            if (!to.isEmpty())
+                lastLine = to.toInt();
+        }
+    }
+    diagnosticsModel->setLineFilter(firstLine, lastLine);
 }
 
 void MainWindow::setupFileMenu()
@@ -242,8 +883,37 @@ void MainWindow::setupFileMenu()
     fileMenu->addAction(tr("&New"), this, SLOT(newFile()), QKeySequence::New);
     fileMenu->addAction(tr("&Open..."), this, SLOT(openFile()), QKeySequence::Open);
     fileMenu->addAction(tr("&Save"), this, SLOT(saveFile()), QKeySequence::Save);
-    fileMenu->addAction(tr("E&xit"), qApp, SLOT(quit()), QKeySequence::Quit);
+    fileMenu->addAction(tr("C&lose Tab"), this, SLOT(closeCurrentTab()), QKeySequence::Close);
+    fileMenu->addAction(tr("E&xit"), this, SLOT(close()), QKeySequence::Quit);
+    fileMenu->addAction(tr("Chec&k"), this, SLOT(checkFile()), QKeySequence(Qt::CTRL + Qt::Key_K));
+    fileMenu->addAction(tr("Check &Project..."), this, SLOT(checkProject()), QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_K));
     fileMenu->addAction(tr("&Compile"), this, SLOT(compileFile()), QKeySequence(Qt::CTRL + Qt::Key_R));
+    fileMenu->addAction(tr("S&top"), this, SLOT(stopProgram()), QKeySequence(Qt::CTRL + Qt::Key_Period));
+}
+
+void MainWindow::setupEditMenu()
+{
+    findBar = new FindBar(editor);
+    findBar->hide();
+
+    QMenu *editMenu = new QMenu(tr("&Edit"), this);
+    menuBar()->addMenu(editMenu);
+
+    // The editor handles these keys itself; the shortcuts here are only shown.
+    QAction *undoAction = editMenu->addAction(tr("&Undo"), editor, SLOT(undo()), QKeySequence::Undo);
+    undoAction->setShortcutContext(Qt::WidgetShortcut);
+    undoAction->setEnabled(false);
+    connect(editor->undoStack(), SIGNAL(undoAvailable(bool)), undoAction, SLOT(setEnabled(bool)));
+    QAction *redoAction = editMenu->addAction(tr("&Redo"), editor, SLOT(redo()), QKeySequence::Redo);
+    redoAction->setShortcutContext(Qt::WidgetShortcut);
+    redoAction->setEnabled(false);
+    connect(editor->undoStack(), SIGNAL(redoAvailable(bool)), redoAction, SLOT(setEnabled(bool)));
+    editMenu->addSeparator();
+
+    editMenu->addAction(tr("&Find..."), findBar, SLOT(activate()), QKeySequence::Find);
+    editMenu->addAction(tr("Find &Next"), findBar, SLOT(findNext()), QKeySequence::FindNext);
+    editMenu->addAction(tr("Find &Previous"), findBar, SLOT(findPrevious()), QKeySequence::FindPrevious);
+    editMenu->addAction(tr("&Replace..."), findBar, SLOT(activate()), QKeySequence::Replace);
 }
 
 void MainWindow::setupSettingMenu(){
@@ -251,6 +921,97 @@ void MainWindow::setupSettingMenu(){
     menuBar()->addMenu(settingMenu);
 
     settingMenu->addAction(tr("&set arguments"), this, SLOT(setArgs()), QKeySequence(Qt::CTRL + Qt::Key_A));
+    settingMenu->addAction(tr("Set &interpreter..."), this, SLOT(setInterpreter()));
+    settingMenu->addAction(tr("&Undo memory..."), this, SLOT(setUndoBudget()));
+    QAction *warmAction = settingMenu->addAction(tr("Keep interpreter &warm"));
+    warmAction->setCheckable(true);
+    warmAction->setChecked(QSettings().value("run/warm", false).toBool());
+#ifndef Q_OS_UNIX
+    warmAction->setEnabled(false);
+#endif
+    connect(warmAction, SIGNAL(toggled(bool)), this, SLOT(setWarmRun(bool)));
+
+    QMenu *highlightMenu = settingMenu->addMenu(tr("&Highlighting"));
+    QActionGroup *highlightGroup = new QActionGroup(this);
+    const QStringList modeNames = QStringList() << tr("&Synchronous") << tr("&Background")
+                                                << tr("&Lazy (visible lines only)");
+    const int modes[] = { QCodeCPP::Synchronous, QCodeCPP::Background, QCodeCPP::Lazy };
+    for (int i = 0; i < modeNames.size(); i++) {
+        QAction *action = highlightMenu->addAction(modeNames.at(i));
+        action->setCheckable(true);
+        action->setChecked(modes[i] == QCodeCPP::Synchronous);
+        action->setData(modes[i]);
+        highlightGroup->addAction(action);
+    }
+    connect(highlightGroup, SIGNAL(triggered(QAction*)), this, SLOT(setHighlightMode(QAction*)));
+
+    QAction *liveCheckAction = settingMenu->addAction(tr("Check while &typing"));
+    liveCheckAction->setCheckable(true);
+    connect(liveCheckAction, SIGNAL(toggled(bool)), this, SLOT(setLiveCheck(bool)));
+
+    QAction *incrementalAction = settingMenu->addAction(tr("&Incremental live check"));
+    incrementalAction->setCheckable(true);
+    incrementalAction->setStatusTip(tr("Reparse only the changed declarations while typing; "
+                                       "uses of other declarations may be reported as errors "
+                                       "until the next full check"));
+    connect(incrementalAction, SIGNAL(toggled(bool)), this, SLOT(setIncrementalCheck(bool)));
+
+    QAction *diskCacheAction = settingMenu->addAction(tr("Cache diagnostics on &disk"));
+    diskCacheAction->setCheckable(true);
+    diskCacheAction->setChecked(QSettings().value("check/diskCache", false).toBool());
+    DiagnosticsCache::instance()->setDiskEnabled(diskCacheAction->isChecked());
+    connect(diskCacheAction, SIGNAL(toggled(bool)), this, SLOT(setDiskCache(bool)));
+
+#ifdef QCODEEDIT_PROFILING
+    QAction *overlayAction = settingMenu->addAction(tr("Performance &overlay"));
+    overlayAction->setCheckable(true);
+    connect(overlayAction, SIGNAL(toggled(bool)), this, SLOT(setProfilerOverlay(bool)));
+    settingMenu->addAction(tr("Export &trace..."), this, SLOT(exportTrace()));
+#endif
+}
+
+#ifdef QCODEEDIT_PROFILING
+void MainWindow::setProfilerOverlay(bool visible)
+{
+    profilerLabel->setVisible(visible);
+    if (visible) {
+        updateProfilerOverlay();
+        profilerTimer->start();
+    } else {
+        profilerTimer->stop();
+    }
+}
+
+void MainWindow::updateProfilerOverlay()
+{
+    profilerLabel->setText(QCodeProfiler::instance()->summary(3));
+}
+
+void MainWindow::exportTrace()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, tr("Export Trace"), "trace.json",
+                                                          tr("Chrome trace (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    QString error;
+    if (!QCodeProfiler::instance()->writeChromeTrace(fileName, &error))
+        QMessageBox::warning(this, tr("Export Trace"), tr("Could not write %1:\n%2").arg(fileName, error));
+}
+#endif
+
+void MainWindow::setLiveCheck(bool enabled)
+{
+    liveChecker->setEnabled(enabled);
+}
+
+void MainWindow::setIncrementalCheck(bool enabled)
+{
+    liveChecker->setIncremental(enabled);
+}
+
+void MainWindow::setHighlightMode(QAction *action)
+{
+    highlighter->setMode(QCodeCPP::Mode(action->data().toInt()));
 }
 
 void MainWindow::setArgs(){
@@ -267,18 +1028,3 @@ void MainWindow::setupHelpMenu()
     menuBar()->addMenu(helpMenu);
     helpMenu->addAction(tr("&About"), this, SLOT(about()));
 }
-
-void MainWindow::insertToTable(bool isWarning, int row, int col, const std::string &msg) {
-
-    int rowCount = errorTable->rowCount();
-    errorTable->insertRow(rowCount);
-
-    errorTable->setItem(rowCount, 0, new QTableWidgetItem(QString::number(row)));
-    errorTable->setItem(rowCount, 1, new QTableWidgetItem(QString::number(col)));
-    errorTable->setItem(rowCount, 2, new QTableWidgetItem(QString::fromStdString(msg)));
-
-    for (int i = 0; i < 3; i++) {
-        errorTable->item(rowCount,i)->setFlags(errorTable->item(rowCount,i)->flags() ^ Qt::ItemIsEditable);
-        errorTable->item(rowCount,i)->setBackground(isWarning ? QColor::fromRgb(255,193,37) : QColor::fromRgb(238,99,99));
-    }
-}
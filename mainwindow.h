@@ -26,12 +26,35 @@
 
 #include "QCodeEdit/qcodecpp.h"
 #include "QCodeEdit/qcodeedit.h"
+#include "QCodeEdit/qcodeprofiler.h"
+#include "cmmcheck.h"
+#include "programrunner.h"
 #include <string>
 
 #include <QMainWindow>
 #include <QPushButton>
 #include <QWidget>
-#include <QTableWidget>
+#include <QTableView>
+
+class FileLoader;
+class FileSaver;
+class LiveChecker;
+class DiagnosticsModel;
+class OutputConsole;
+class ProjectChecker;
+class RunClient;
+class FindBar;
+
+QT_BEGIN_NAMESPACE
+class QCloseEvent;
+class QComboBox;
+class QDockWidget;
+class QLabel;
+class QLineEdit;
+class QProgressBar;
+class QTabBar;
+class QTimer;
+QT_END_NAMESPACE
 
 class MainWindow : public QMainWindow
 {
@@ -44,29 +67,130 @@ public slots:
     void about();
     void newFile();
     void openFile(const QString &path = QString());
+    void closeTab(int index);
+    void closeCurrentTab();
     void saveFile();
     void compileFile();
+    void stopProgram();
     bool FileHasError();
-    void jumpToBug(QTableWidgetItem *);
+    void checkFile();
+    void checkProject();
+    void jumpToBug(const QModelIndex &index);
     void changeState();
     void setArgs();
+    void setHighlightMode(QAction *action);
+    void setLiveCheck(bool enabled);
+    void setIncrementalCheck(bool enabled);
+    void setInterpreter();
+    void setWarmRun(bool enabled);
+    void setDiskCache(bool enabled);
+    void setUndoBudget();
+
+protected:
+    void closeEvent(QCloseEvent *event);
+
+private slots:
+    void switchTab(int index);
+    void moveTab(int from, int to);
+    void appendLoadedChunk(const QString &text);
+    void updateLoadProgress(qint64 bytesRead, qint64 bytesTotal);
+    void loadFinished();
+    void loadFailed(const QString &message);
+    void saveFinished();
+    void saveFailed(const QString &message);
+    void showDiagnostics(const DiagnosticList &diagnostics);
+    void projectCheckStarted(int fileCount);
+    void projectFilesChecked(const FileCheckList &files);
+    void projectCheckProgress(int checked, int total);
+    void projectCheckFinished(int fileCount, int failedCount, qint64 elapsedMs);
+    void filterDiagnostics();
+    void appendOutput(const QString &text, bool isError);
+    void sendInput();
+    void saveOutput();
+    void runFinished(const ProgramRunner::Result &result);
+    void runFailed(const QString &message);
+#ifdef QCODEEDIT_PROFILING
+    void setProfilerOverlay(bool visible);
+    void updateProfilerOverlay();
+    void exportTrace();
+#endif
 
 private:
     void setupEditor();
     void setupFileMenu();
+    void setupEditMenu();
     void setupHelpMenu();
     void setupSettingMenu();
     void setupTable();
-    void insertToTable(bool isWarning, int row, int col, const std::string &msg);
+    void setupOutputDock();
+    void setupTabs();
+    int addTab(const QString &fileName);
+    int findTab(const QString &fileName) const;
+    bool isTabSaved(int index) const;
+    void stashTab(int index);
+    void switchToDeferredTab();
+    void activateTab(int index);
+    void updateTabTitle();
+    void startLoading(const QString &fileName);
+    void showCachedDiagnostics();
+    void goToLocation(int row, int col);
+    QString interpreterPath() const;
+    bool isProgramRunning() const;
+    void showOutputPane();
+    void cancelLoading();
+    void finishSave();
 
 Q_SIGNALS:
-    void itemDoubleClicked(QTableWidgetItem *item);
     void textChanged();
 
 private:
+    // A document that is not in the editor. Its text is kept as UTF-8 and
+    // only turned back into a QTextDocument when the tab is activated; a
+    // file opened in the background is not even read until then.
+    struct DocumentTab
+    {
+        QString fileName;
+        QByteArray text;
+        bool onDisk;
+        bool saved;
+        int cursorPosition;
+        int scrollPosition;
+    };
+
     QCodeEdit *editor;
+    QTabBar *tabBar;
+    QVector<DocumentTab> tabs;
+    int activeTab = -1;
+    int deferredTab = -1;       // switched to once the active tab has loaded
     QCodeCPP *highlighter;
-    QTableWidget *errorTable;
+    FindBar *findBar;
+    QTableView *errorTable;
+    DiagnosticsModel *diagnosticsModel;
+    ProjectChecker *projectChecker;
+    QWidget *diagnosticsPane;
+    QComboBox *severityFilter;
+    QLineEdit *lineFilter;
+    QProgressBar *loadProgressBar;
+    LiveChecker *liveChecker;
+    ProgramRunner *runner;
+    RunClient *runClient;
+    bool warmRun;
+    QDockWidget *outputDock;
+    OutputConsole *outputConsole;
+    QLineEdit *inputLine;
+    QLabel *runStatus;
+#ifdef QCODEEDIT_PROFILING
+    QLabel *profilerLabel;
+    QTimer *profilerTimer;
+#endif
+    FileLoader *loader = nullptr;
+    bool appendingChunk = false;
+    FileSaver *saver = nullptr;
+    QCodeSpan openSpan = 0;
+    QCodeSpan saveSpan = 0;
+    QString queuedSave;
+    int pendingJumpRow = 0;
+    int pendingJumpCol = 0;
     QString currentFileName = "";
     QString mainWindowTitle;
     QString arguments;
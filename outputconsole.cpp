@@ -0,0 +1,320 @@
+/**
+* @file  outputconsole.cpp
+* @brief Source implementing a bounded, virtualized program output view.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include <QtWidgets>
+
+#include "outputconsole.h"
+
+namespace {
+
+const int DefaultMaximumLines = 200000;
+const qint64 DefaultMaximumCharacters = 32 * 1024 * 1024;
+const int MaxLineLength = 64 * 1024;     // longer lines continue on the next row
+const int FrameInterval = 16;
+const int TextMargin = 4;
+
+} // namespace
+
+OutputConsole::OutputConsole(QWidget *parent)
+    : QAbstractScrollArea(parent), lines(DefaultMaximumLines), lastLineOpen(false),
+      carriageReturn(false), characterCount(0), characterBudget(DefaultMaximumCharacters),
+      droppedLines(0), longestLine(0), spill(0)
+{
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FrameInterval);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushPending()));
+}
+
+void OutputConsole::setMaximumLines(int count)
+{
+    flushPending();
+    while (lines.count() > count)
+        dropOldest();
+    lines.setCapacity(qMax(1, count));
+    updateScrollBars();
+    viewport()->update();
+}
+
+void OutputConsole::setMaximumCharacters(qint64 count)
+{
+    flushPending();
+    characterBudget = count;
+    while (characterCount > characterBudget && lines.count() > 1)
+        dropOldest();
+    updateScrollBars();
+    viewport()->update();
+}
+
+void OutputConsole::append(const QString &text, bool isError)
+{
+    // Applied by flushPending() at most once per frame.
+    if (!pending.isEmpty() && pending.last().isError == isError) {
+        pending.last().text += text;
+    } else {
+        Chunk chunk;
+        chunk.text = text;
+        chunk.isError = isError;
+        pending.append(chunk);
+    }
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void OutputConsole::clear()
+{
+    flushTimer->stop();
+    pending.clear();
+    lines.clear();
+    lastLineOpen = false;
+    carriageReturn = false;
+    characterCount = 0;
+    droppedLines = 0;
+    longestLine = 0;
+    if (spill) {
+        spill->resize(0);
+        spill->seek(0);
+    }
+    updateScrollBars();
+    viewport()->update();
+}
+
+void OutputConsole::setSpillEnabled(bool enabled)
+{
+    if (enabled == isSpillEnabled())
+        return;
+
+    if (!enabled) {
+        delete spill;
+        spill = 0;
+        return;
+    }
+
+    flushPending();
+    spill = new QTemporaryFile(QDir::tempPath() + "/cmm-output-XXXXXX.log", this);
+    if (!spill->open()) {
+        delete spill;
+        spill = 0;
+        return;
+    }
+    // The log starts with what is still held in memory.
+    for (int i = lines.firstIndex(); i <= lines.lastIndex(); ++i) {
+        spill->write(lines.at(i).text.toUtf8());
+        if (i < lines.lastIndex() || !lastLineOpen)
+            spill->write("\n");
+    }
+}
+
+bool OutputConsole::saveOutput(const QString &fileName, QString *errorString)
+{
+    flushPending();
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        *errorString = file.errorString();
+        return false;
+    }
+
+    if (spill) {
+        spill->flush();
+        spill->seek(0);
+        QByteArray buffer;
+        do {
+            buffer = spill->read(1024 * 1024);
+            file.write(buffer);
+        } while (!buffer.isEmpty());
+        spill->seek(spill->size());
+    } else {
+        for (int i = lines.firstIndex(); i <= lines.lastIndex(); ++i) {
+            file.write(lines.at(i).text.toUtf8());
+            if (i < lines.lastIndex() || !lastLineOpen)
+                file.write("\n");
+        }
+    }
+
+    if (!file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void OutputConsole::flushPending()
+{
+    flushTimer->stop();
+    if (pending.isEmpty())
+        return;
+
+    QScrollBar *scrollBar = verticalScrollBar();
+    const bool follow = scrollBar->value() == scrollBar->maximum();
+    const qint64 droppedBefore = droppedLines;
+
+    for (const Chunk &chunk : pending) {
+        if (spill)
+            spill->write(chunk.text.toUtf8());
+        appendText(chunk.text, chunk.isError);
+    }
+    pending.clear();
+
+    updateScrollBars();
+    // Rows scrolled back to stay put while old lines are dropped above them.
+    if (follow)
+        scrollBar->setValue(scrollBar->maximum());
+    else
+        scrollBar->setValue(scrollBar->value() - int(droppedLines - droppedBefore));
+    viewport()->update();
+}
+
+void OutputConsole::appendText(const QString &text, bool isError)
+{
+    int start = 0;
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c != QLatin1Char('\n') && c != QLatin1Char('\r'))
+            continue;
+
+        appendToOpenLine(text, start, i, isError);
+        if (c == QLatin1Char('\n')) {
+            openLine(isError);
+            lastLineOpen = false;
+            carriageReturn = false;
+        } else {
+            // A bare carriage return rewinds the line, as progress output expects.
+            carriageReturn = true;
+        }
+        start = i + 1;
+    }
+    appendToOpenLine(text, start, text.size(), isError);
+
+    while (characterCount > characterBudget && lines.count() > 1)
+        dropOldest();
+}
+
+void OutputConsole::appendToOpenLine(const QString &text, int from, int to, bool isError)
+{
+    if (from == to)
+        return;
+
+    openLine(isError);
+    if (carriageReturn) {
+        characterCount -= lines.last().text.size();
+        lines.last().text.clear();
+        carriageReturn = false;
+    }
+
+    while (from < to) {
+        if (lines.last().text.size() >= MaxLineLength) {
+            lastLineOpen = false;
+            openLine(isError);
+        }
+        Line &line = lines.last();
+        const int count = qMin(to - from, MaxLineLength - line.text.size());
+        line.text += text.midRef(from, count);
+        line.isError = line.isError || isError;
+        characterCount += count;
+        longestLine = qMax(longestLine, line.text.size());
+        from += count;
+    }
+}
+
+void OutputConsole::openLine(bool isError)
+{
+    if (lastLineOpen)
+        return;
+
+    if (lines.count() == lines.capacity())
+        dropOldest();
+    Line line;
+    line.isError = isError;
+    lines.append(line);
+    if (!lines.areIndexesValid())
+        lines.normalizeIndexes();
+    lastLineOpen = true;
+}
+
+void OutputConsole::dropOldest()
+{
+    characterCount -= lines.first().text.size();
+    lines.removeFirst();
+    ++droppedLines;
+    if (lines.isEmpty())
+        lastLineOpen = false;
+}
+
+void OutputConsole::updateScrollBars()
+{
+    const QFontMetrics metrics = fontMetrics();
+    const int rows = qMax(1, viewport()->height() / metrics.height());
+    verticalScrollBar()->setRange(0, qMax(0, lines.count() - rows));
+    verticalScrollBar()->setPageStep(rows);
+
+    const int width = longestLine * metrics.averageCharWidth() + 2 * TextMargin;
+    horizontalScrollBar()->setRange(0, qMax(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+}
+
+void OutputConsole::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(viewport());
+    painter.fillRect(event->rect(), palette().base());
+
+    // Only the rows and columns inside the exposed area are drawn, however
+    // many lines are held or however long they are.
+    const QFontMetrics metrics = fontMetrics();
+    const int lineHeight = metrics.height();
+    const int charWidth = qMax(1, metrics.averageCharWidth());
+    const int top = verticalScrollBar()->value();
+    const int first = top + event->rect().top() / lineHeight;
+    const int last = qMin(lines.count() - 1, top + event->rect().bottom() / lineHeight);
+    const int scrollX = horizontalScrollBar()->value();
+    const int firstColumn = qMax(0, (scrollX - TextMargin) / charWidth);
+    const int columns = viewport()->width() / charWidth + 2;
+
+    for (int row = first; row <= last; ++row) {
+        const Line &line = lines.at(lines.firstIndex() + row);
+        if (line.text.size() <= firstColumn)
+            continue;
+        painter.setPen(line.isError ? QColor(Qt::red) : palette().color(QPalette::Text));
+        painter.drawText(TextMargin - scrollX + firstColumn * charWidth,
+                         (row - top) * lineHeight + metrics.ascent(),
+                         line.text.mid(firstColumn, columns));
+    }
+}
+
+void OutputConsole::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void OutputConsole::changeEvent(QEvent *event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (event->type() == QEvent::FontChange) {
+        updateScrollBars();
+        viewport()->update();
+    }
+}
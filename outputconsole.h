@@ -0,0 +1,107 @@
+/**
+* @file  outputconsole.h
+* @brief Header implementing a bounded, virtualized program output view.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef OUTPUTCONSOLE_H
+#define OUTPUTCONSOLE_H
+
+#include <QAbstractScrollArea>
+#include <QContiguousCache>
+#include <QString>
+#include <QVector>
+
+QT_BEGIN_NAMESPACE
+class QTemporaryFile;
+class QTimer;
+QT_END_NAMESPACE
+
+// Shows program output from a ring buffer of lines: once the line or
+// character budget is used up the oldest lines are dropped, so memory stays
+// bounded however much a program prints. Appends are collected and applied
+// once per frame, and painting only touches the rows in the viewport. With
+// spilling enabled everything is also written to a temporary file, so the
+// full output can still be saved.
+class OutputConsole : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    OutputConsole(QWidget *parent = 0);
+
+    int maximumLines() const { return lines.capacity(); }
+    void setMaximumLines(int count);
+    qint64 maximumCharacters() const { return characterBudget; }
+    void setMaximumCharacters(qint64 count);
+
+    int lineCount() const { return lines.count(); }
+    qint64 droppedLineCount() const { return droppedLines; }
+    bool isSpillEnabled() const { return spill != 0; }
+
+    bool saveOutput(const QString &fileName, QString *errorString);
+
+public slots:
+    void append(const QString &text, bool isError = false);
+    void clear();
+    void setSpillEnabled(bool enabled);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void resizeEvent(QResizeEvent *event);
+    void changeEvent(QEvent *event);
+
+private slots:
+    void flushPending();
+
+private:
+    struct Line
+    {
+        QString text;
+        bool isError;
+    };
+
+    struct Chunk
+    {
+        QString text;
+        bool isError;
+    };
+
+    void appendText(const QString &text, bool isError);
+    void openLine(bool isError);
+    void appendToOpenLine(const QString &text, int from, int to, bool isError);
+    void dropOldest();
+    void updateScrollBars();
+
+    QContiguousCache<Line> lines;
+    bool lastLineOpen;
+    bool carriageReturn;
+    qint64 characterCount;
+    qint64 characterBudget;
+    qint64 droppedLines;
+    int longestLine;
+
+    QVector<Chunk> pending;
+    QTimer *flushTimer;
+    QTemporaryFile *spill;
+};
+
+#endif // OUTPUTCONSOLE_H
@@ -0,0 +1,216 @@
+/**
+* @file  programrunner.cpp
+* @brief Source implementing the interpreter run pipeline.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "programrunner.h"
+
+#include <QFile>
+#include <QTextCodec>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+const int RssSampleInterval = 100;
+const int TerminateGraceMs = 2000;
+
+} // namespace
+
+ProgramRunner::ProgramRunner(QObject *parent)
+    : QObject(parent), peakRssKb(-1), childrenPeakBefore(-1), cancelled(false)
+{
+    process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::SeparateChannels);
+    connect(process, SIGNAL(started()), this, SLOT(processStarted()));
+    connect(process, SIGNAL(readyReadStandardOutput()), this, SLOT(readStandardOutput()));
+    connect(process, SIGNAL(readyReadStandardError()), this, SLOT(readStandardError()));
+    connect(process, SIGNAL(finished(int,QProcess::ExitStatus)),
+            this, SLOT(processFinished(int,QProcess::ExitStatus)));
+    connect(process, SIGNAL(error(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+
+    rssTimer = new QTimer(this);
+    rssTimer->setInterval(RssSampleInterval);
+    connect(rssTimer, SIGNAL(timeout()), this, SLOT(samplePeakRss()));
+
+    killTimer = new QTimer(this);
+    killTimer->setSingleShot(true);
+    killTimer->setInterval(TerminateGraceMs);
+    connect(killTimer, SIGNAL(timeout()), process, SLOT(kill()));
+}
+
+ProgramRunner::~ProgramRunner()
+{
+    if (isRunning()) {
+        process->kill();
+        process->waitForFinished();
+    }
+}
+
+bool ProgramRunner::isRunning() const
+{
+    return process->state() != QProcess::NotRunning;
+}
+
+void ProgramRunner::start(const QString &interpreter, const QString &fileName, const QStringList &arguments)
+{
+    if (isRunning())
+        return;
+
+    QTextCodec *codec = QTextCodec::codecForLocale();
+    stdoutDecoder.reset(codec->makeDecoder());
+    stderrDecoder.reset(codec->makeDecoder());
+    peakRssKb = -1;
+    childrenPeakBefore = childrenPeakRssKb();
+    cancelled = false;
+
+    process->start(interpreter, QStringList() << fileName << arguments);
+}
+
+void ProgramRunner::writeInput(const QString &text)
+{
+    if (isRunning())
+        process->write(text.toLocal8Bit());
+}
+
+void ProgramRunner::cancel()
+{
+    if (!isRunning())
+        return;
+    cancelled = true;
+#ifdef Q_OS_WIN
+    process->kill();
+#else
+    // Give the program a chance to restore the terminal before it is killed.
+    process->terminate();
+    killTimer->start();
+#endif
+}
+
+void ProgramRunner::processStarted()
+{
+    clock.start();
+    rssTimer->start();
+    emit started();
+}
+
+void ProgramRunner::readStandardOutput()
+{
+    const QString text = stdoutDecoder->toUnicode(process->readAllStandardOutput());
+    if (!text.isEmpty())
+        emit output(text, false);
+}
+
+void ProgramRunner::readStandardError()
+{
+    const QString text = stderrDecoder->toUnicode(process->readAllStandardError());
+    if (!text.isEmpty())
+        emit output(text, true);
+}
+
+void ProgramRunner::processFinished(int exitCode, QProcess::ExitStatus status)
+{
+    rssTimer->stop();
+    killTimer->stop();
+    readStandardOutput();
+    readStandardError();
+
+    // RUSAGE_CHILDREN keeps the largest child ever waited for, so it only
+    // describes this run when it went up.
+    const qint64 childrenPeak = childrenPeakRssKb();
+    if (childrenPeak > childrenPeakBefore)
+        peakRssKb = qMax(peakRssKb, childrenPeak);
+
+    Result result;
+    result.exitCode = exitCode;
+    result.crashed = status == QProcess::CrashExit;
+    result.cancelled = cancelled;
+    result.wallMs = clock.isValid() ? clock.elapsed() : 0;
+    result.peakRssKb = peakRssKb;
+    emit finished(result);
+}
+
+void ProgramRunner::processError(QProcess::ProcessError error)
+{
+    if (error == QProcess::FailedToStart)
+        emit failed(process->errorString());
+}
+
+void ProgramRunner::samplePeakRss()
+{
+#ifdef Q_OS_LINUX
+    QFile status(QString("/proc/%1/status").arg(process->processId()));
+    if (!status.open(QIODevice::ReadOnly))
+        return;
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        if (line.startsWith("VmHWM:")) {
+            peakRssKb = qMax(peakRssKb, line.mid(6).trimmed().split(' ').value(0).toLongLong());
+            break;
+        }
+    }
+#endif
+}
+
+qint64 ProgramRunner::childrenPeakRssKb()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_CHILDREN, &usage) != 0)
+        return -1;
+#ifdef Q_OS_MAC
+    return usage.ru_maxrss / 1024;     // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+QStringList ProgramRunner::splitArguments(const QString &command)
+{
+    QStringList arguments;
+    QString current;
+    bool quoted = false;
+    bool pending = false;
+    for (const QChar c : command) {
+        if (c == QLatin1Char('"')) {
+            quoted = !quoted;
+            pending = true;
+        } else if (c.isSpace() && !quoted) {
+            if (pending)
+                arguments << current;
+            current.clear();
+            pending = false;
+        } else {
+            current += c;
+            pending = true;
+        }
+    }
+    if (pending)
+        arguments << current;
+    return arguments;
+}
@@ -0,0 +1,98 @@
+/**
+* @file  programrunner.h
+* @brief Header implementing the interpreter run pipeline.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef PROGRAMRUNNER_H
+#define PROGRAMRUNNER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QProcess>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextDecoder>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+// Runs a program under the CMM interpreter and streams its output back as
+// it arrives. Every run reports its exit code, wall-clock time and peak
+// resident memory; the peak is sampled from /proc while the program runs
+// and completed with getrusage() once it has exited.
+class ProgramRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Result
+    {
+        int exitCode;
+        bool crashed;
+        bool cancelled;
+        qint64 wallMs;
+        qint64 peakRssKb;   // -1 where the platform does not tell
+    };
+
+    ProgramRunner(QObject *parent = 0);
+    ~ProgramRunner();
+
+    bool isRunning() const;
+    void start(const QString &interpreter, const QString &fileName, const QStringList &arguments);
+    void writeInput(const QString &text);
+
+    // Splits a command line on spaces, keeping double-quoted parts together.
+    static QStringList splitArguments(const QString &command);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void output(const QString &text, bool isError);
+    void finished(const ProgramRunner::Result &result);
+    void failed(const QString &message);
+
+private slots:
+    void processStarted();
+    void readStandardOutput();
+    void readStandardError();
+    void processFinished(int exitCode, QProcess::ExitStatus status);
+    void processError(QProcess::ProcessError error);
+    void samplePeakRss();
+
+private:
+    static qint64 childrenPeakRssKb();
+
+    QProcess *process;
+    QTimer *rssTimer;
+    QTimer *killTimer;
+    QElapsedTimer clock;
+    QScopedPointer<QTextDecoder> stdoutDecoder;
+    QScopedPointer<QTextDecoder> stderrDecoder;
+    qint64 peakRssKb;
+    qint64 childrenPeakBefore;
+    bool cancelled;
+};
+
+#endif // PROGRAMRUNNER_H
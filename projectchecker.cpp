@@ -0,0 +1,194 @@
+/**
+* @file  projectchecker.cpp
+* @brief Source implementing a parallel check of every CMM file under a folder.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "projectchecker.h"
+#include "diagnosticscache.h"
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QTimer>
+#include <QtConcurrent>
+
+#include <climits>
+
+namespace {
+
+// Results are collected for this long before the view is updated.
+const int FlushIntervalMs = 100;
+
+} // namespace
+
+ProjectChecker::ProjectChecker(QObject *parent)
+    : QObject(parent), checkedCount(0), failedCount(0)
+{
+    discoveryWatcher = new QFutureWatcher<QStringList>(this);
+    connect(discoveryWatcher, SIGNAL(finished()), this, SLOT(discoveryFinished()));
+
+    checkWatcher = new QFutureWatcher<FileCheck>(this);
+    connect(checkWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(fileReady(int)));
+    connect(checkWatcher, SIGNAL(finished()), this, SLOT(checkFinished()));
+
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushIntervalMs);
+    connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushResults()));
+}
+
+void ProjectChecker::start(const QString &directory)
+{
+    cancel();
+    readyResults.clear();
+    checkedCount = 0;
+    failedCount = 0;
+    elapsed.start();
+
+    // Walking a large tree takes a while too, so it is not done here.
+    discoveryWatcher->setFuture(QtConcurrent::run(&ProjectChecker::discover, QStringList() << directory));
+}
+
+bool ProjectChecker::isRunning() const
+{
+    return discoveryWatcher->isRunning() || checkWatcher->isRunning();
+}
+
+void ProjectChecker::cancel()
+{
+    // Files already being parsed finish on their threads; the slots below
+    // drop whatever a cancelled run still reports.
+    discoveryWatcher->cancel();
+    checkWatcher->cancel();
+    flushTimer->stop();
+    readyResults.clear();
+}
+
+QStringList ProjectChecker::discover(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        if (!QFileInfo(path).isDir()) {
+            files << path;
+            continue;
+        }
+        QStringList found;
+        QDirIterator it(path, QStringList() << "*.cmm", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            found << it.next();
+        found.sort();
+        files << found;
+    }
+    return files;
+}
+
+FileCheck ProjectChecker::checkFile(const QString &fileName)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    FileCheck result;
+    result.fileName = fileName;
+    result.status = 0;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        result.error = file.errorString();
+        result.status = 1;
+
+        Diagnostic diagnostic;
+        diagnostic.isWarning = false;
+        diagnostic.row = 1;
+        diagnostic.col = 1;
+        diagnostic.message = tr("Could not read the file: %1").arg(result.error);
+        result.diagnostics.append(diagnostic);
+    } else {
+        // Keyed the way the editor's lines are, so a file already checked
+        // in the editor is a cache hit here and the other way round. The
+        // file is mapped and hashed in one pass, without copies or a split
+        // into lines.
+        const qint64 size = file.size();
+        uchar *mapped = size > 0 && size <= INT_MAX ? file.map(0, size) : 0;
+        const QString text = mapped ? QString::fromUtf8(reinterpret_cast<const char *>(mapped), int(size))
+                                    : QString::fromUtf8(file.readAll());
+        if (mapped)
+            file.unmap(mapped);
+        const QDateTime modified = QFileInfo(file).lastModified();
+
+        // SourceMgr only parses from a path, so on a miss the parser reads
+        // the file once more, from the page cache by now. A file that
+        // changed in between is not cached under the old text's key.
+        DiagnosticsCache *cache = DiagnosticsCache::instance();
+        const quint64 key = DiagnosticsCache::key(text);
+        if (!cache->lookup(key, &result.diagnostics, &result.status)) {
+            result.status = CMMCheck::checkFile(fileName, &result.diagnostics);
+            if (QFileInfo(fileName).lastModified() == modified)
+                cache->insert(key, result.diagnostics, result.status);
+        }
+    }
+
+    result.elapsedMs = timer.nsecsElapsed() / 1e6;
+    return result;
+}
+
+void ProjectChecker::discoveryFinished()
+{
+    if (discoveryWatcher->isCanceled())
+        return;
+    const QStringList files = discoveryWatcher->result();
+    emit started(files.size());
+    emit progress(0, files.size());
+    checkWatcher->setFuture(QtConcurrent::mapped(files, &ProjectChecker::checkFile));
+}
+
+void ProjectChecker::fileReady(int index)
+{
+    if (checkWatcher->isCanceled())
+        return;
+    const FileCheck result = checkWatcher->resultAt(index);
+    if (result.status != 0)
+        ++failedCount;
+    ++checkedCount;
+    readyResults.append(result);
+    if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void ProjectChecker::flushResults()
+{
+    if (readyResults.isEmpty())
+        return;
+    const FileCheckList results = readyResults;
+    readyResults.clear();
+    emit filesChecked(results);
+    emit progress(checkedCount, checkWatcher->progressMaximum());
+}
+
+void ProjectChecker::checkFinished()
+{
+    if (checkWatcher->isCanceled())
+        return;
+    flushTimer->stop();
+    flushResults();
+    emit finished(checkedCount, failedCount, elapsed.elapsed());
+}
@@ -0,0 +1,83 @@
+/**
+* @file  projectchecker.h
+* @brief Header implementing a parallel check of every CMM file under a folder.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef PROJECTCHECKER_H
+#define PROJECTCHECKER_H
+
+#include "cmmcheck.h"
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QStringList>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+// Finds the .cmm files under a folder and checks them on the global
+// thread pool, one file per work item, so idle threads keep taking files
+// until none are left. Results are handed out in small batches while the
+// rest are still being parsed.
+class ProjectChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ProjectChecker(QObject *parent = 0);
+
+    void start(const QString &directory);
+    bool isRunning() const;
+
+    // Files as given, folders expanded to the .cmm files below them, sorted.
+    static QStringList discover(const QStringList &paths);
+    // Safe to call from any thread.
+    static FileCheck checkFile(const QString &fileName);
+
+public slots:
+    void cancel();
+
+signals:
+    void started(int fileCount);
+    void filesChecked(const FileCheckList &files);
+    void progress(int checked, int total);
+    void finished(int fileCount, int failedCount, qint64 elapsedMs);
+
+private slots:
+    void discoveryFinished();
+    void fileReady(int index);
+    void flushResults();
+    void checkFinished();
+
+private:
+    QFutureWatcher<QStringList> *discoveryWatcher;
+    QFutureWatcher<FileCheck> *checkWatcher;
+    QTimer *flushTimer;
+    QElapsedTimer elapsed;
+    FileCheckList readyResults;
+    int checkedCount;
+    int failedCount;
+};
+
+#endif // PROJECTCHECKER_H
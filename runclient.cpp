@@ -0,0 +1,202 @@
+/**
+* @file  runclient.cpp
+* @brief Source implementing the editor side of the interpreter run server.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "runclient.h"
+#include "runserver.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QTextCodec>
+#include <QTimer>
+
+namespace {
+
+const int ConnectInterval = 50;
+const int MaxConnectAttempts = 100;
+
+} // namespace
+
+RunClient::RunClient(QObject *parent)
+    : QObject(parent), serverProgram(QCoreApplication::applicationFilePath()),
+      connectAttempts(0), running(false)
+{
+    serverName = QString("cmm-run-%1").arg(QCoreApplication::applicationPid());
+
+    server = new QProcess(this);
+    server->setProcessChannelMode(QProcess::ForwardedChannels);
+    connect(server, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(serverLost()));
+
+    socket = new QLocalSocket(this);
+    connect(socket, SIGNAL(connected()), this, SLOT(socketConnected()));
+    connect(socket, SIGNAL(readyRead()), this, SLOT(readMessages()));
+    connect(socket, SIGNAL(disconnected()), this, SLOT(serverLost()));
+
+    connectTimer = new QTimer(this);
+    connectTimer->setInterval(ConnectInterval);
+    connect(connectTimer, SIGNAL(timeout()), this, SLOT(tryConnect()));
+}
+
+RunClient::~RunClient()
+{
+    // The server quits when its client goes away.
+    socket->disconnect(this);
+    server->disconnect(this);
+    socket->abort();
+    if (server->state() != QProcess::NotRunning && !server->waitForFinished(1000))
+        server->kill();
+}
+
+void RunClient::start(const QString &interpreter, const QString &fileName, const QString &source,
+                      const QStringList &arguments)
+{
+    if (running)
+        return;
+
+    QTextCodec *codec = QTextCodec::codecForLocale();
+    stdoutDecoder.reset(codec->makeDecoder());
+    stderrDecoder.reset(codec->makeDecoder());
+    running = true;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RunServer::RunMessage) << interpreter << fileName << source.toUtf8() << arguments;
+    sendMessage(payload);
+}
+
+void RunClient::writeInput(const QString &text)
+{
+    if (!running)
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RunServer::InputMessage) << text.toLocal8Bit();
+    sendMessage(payload);
+}
+
+void RunClient::cancel()
+{
+    if (!running)
+        return;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(RunServer::CancelMessage);
+    sendMessage(payload);
+}
+
+void RunClient::sendMessage(const QByteArray &payload)
+{
+    if (socket->state() == QLocalSocket::ConnectedState) {
+        socket->write(RunServer::frame(payload));
+        return;
+    }
+
+    // Sent once the server is up.
+    queued += RunServer::frame(payload);
+    if (server->state() == QProcess::NotRunning) {
+        server->start(serverProgram, QStringList() << "--run-server" << serverName);
+        connectAttempts = 0;
+    }
+    if (!connectTimer->isActive())
+        connectTimer->start();
+}
+
+void RunClient::tryConnect()
+{
+    if (socket->state() != QLocalSocket::UnconnectedState)
+        return;
+    if (++connectAttempts > MaxConnectAttempts) {
+        fail(tr("The run server did not start"));
+        return;
+    }
+    socket->connectToServer(serverName);
+}
+
+void RunClient::socketConnected()
+{
+    connectTimer->stop();
+    socket->write(queued);
+    queued.clear();
+}
+
+void RunClient::readMessages()
+{
+    incoming += socket->readAll();
+    QByteArray payload;
+    while (RunServer::takeFrame(&incoming, &payload)) {
+        QDataStream in(payload);
+        quint8 type;
+        in >> type;
+        switch (type) {
+        case RunServer::StartedMessage:
+            emit started();
+            break;
+        case RunServer::OutputMessage: {
+            bool isError;
+            QByteArray data;
+            in >> isError >> data;
+            const QString text = (isError ? stderrDecoder : stdoutDecoder)->toUnicode(data);
+            if (!text.isEmpty())
+                emit output(text, isError);
+            break;
+        }
+        case RunServer::FinishedMessage: {
+            qint32 exitCode;
+            ProgramRunner::Result result;
+            in >> exitCode >> result.crashed >> result.cancelled >> result.wallMs >> result.peakRssKb;
+            result.exitCode = exitCode;
+            running = false;
+            emit finished(result);
+            break;
+        }
+        case RunServer::FailedMessage: {
+            QString message;
+            in >> message;
+            running = false;
+            emit failed(message);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void RunClient::serverLost()
+{
+    connectTimer->stop();
+    socket->abort();
+    incoming.clear();
+    if (running)
+        fail(tr("The run server exited"));
+}
+
+void RunClient::fail(const QString &message)
+{
+    connectTimer->stop();
+    queued.clear();
+    running = false;
+    emit failed(message);
+}
@@ -0,0 +1,92 @@
+/**
+* @file  runclient.h
+* @brief Header implementing the editor side of the interpreter run server.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef RUNCLIENT_H
+#define RUNCLIENT_H
+
+#include "programrunner.h"
+
+#include <QByteArray>
+#include <QObject>
+#include <QScopedPointer>
+#include <QStringList>
+#include <QTextDecoder>
+
+QT_BEGIN_NAMESPACE
+class QLocalSocket;
+class QProcess;
+class QTimer;
+QT_END_NAMESPACE
+
+// Starts this executable as a RunServer on first use and keeps it around,
+// so later runs skip process start-up in the editor. Reports through the
+// same signals as ProgramRunner.
+class RunClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    RunClient(QObject *parent = 0);
+    ~RunClient();
+
+    bool isRunning() const { return running; }
+    // The executable started with --run-server; this one by default.
+    void setServerProgram(const QString &program) { serverProgram = program; }
+    void start(const QString &interpreter, const QString &fileName, const QString &source,
+               const QStringList &arguments);
+    void writeInput(const QString &text);
+
+public slots:
+    void cancel();
+
+signals:
+    void started();
+    void output(const QString &text, bool isError);
+    void finished(const ProgramRunner::Result &result);
+    void failed(const QString &message);
+
+private slots:
+    void tryConnect();
+    void socketConnected();
+    void readMessages();
+    void serverLost();
+
+private:
+    void sendMessage(const QByteArray &payload);
+    void fail(const QString &message);
+
+    QProcess *server;
+    QLocalSocket *socket;
+    QTimer *connectTimer;
+    QString serverProgram;
+    QString serverName;
+    QByteArray incoming;
+    QByteArray queued;
+    QScopedPointer<QTextDecoder> stdoutDecoder;
+    QScopedPointer<QTextDecoder> stderrDecoder;
+    int connectAttempts;
+    bool running;
+};
+
+#endif // RUNCLIENT_H
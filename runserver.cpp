@@ -0,0 +1,434 @@
+/**
+* @file  runserver.cpp
+* @brief Source implementing the persistent interpreter run server.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#include "runserver.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QtEndian>
+#include <QVector>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const int ReapInterval = 20;
+const int TerminateGraceMs = 2000;
+
+// Limits every program runs under.
+const rlim_t CpuSeconds = 120;
+const rlim_t AddressSpace = rlim_t(4) * 1024 * 1024 * 1024;
+const rlim_t FileSize = rlim_t(1) * 1024 * 1024 * 1024;
+
+void setLimit(int resource, rlim_t value)
+{
+    struct rlimit limit;
+    limit.rlim_cur = value;
+    limit.rlim_max = value;
+    setrlimit(resource, &limit);
+}
+
+bool makePipe(int fds[2])
+{
+    if (pipe(fds) != 0)
+        return false;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    return true;
+}
+
+} // namespace
+
+RunServer::RunServer(QObject *parent)
+    : QObject(parent), client(0), child(-1), stdinFd(-1), stdoutFd(-1), stderrFd(-1),
+      stdinNotifier(0), stdoutNotifier(0), stderrNotifier(0), cancelled(false)
+{
+    server = new QLocalServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(acceptConnection()));
+
+    reapTimer = new QTimer(this);
+    reapTimer->setInterval(ReapInterval);
+    connect(reapTimer, SIGNAL(timeout()), this, SLOT(reapChild()));
+
+    killTimer = new QTimer(this);
+    killTimer->setSingleShot(true);
+    killTimer->setInterval(TerminateGraceMs);
+    connect(killTimer, SIGNAL(timeout()), this, SLOT(killChild()));
+}
+
+RunServer::~RunServer()
+{
+    if (child > 0) {
+        ::kill(-pid_t(child), SIGKILL);
+        waitpid(pid_t(child), 0, 0);
+    }
+    closeChildPipes();
+}
+
+bool RunServer::listen(const QString &name)
+{
+    // A server that crashed may have left its socket file behind.
+    QLocalServer::removeServer(name);
+    // A child that exits or closes its input must fail the next write with
+    // EPIPE instead of killing the server.
+    ::signal(SIGPIPE, SIG_IGN);
+    return workDir.isValid() && server->listen(name);
+}
+
+QByteArray RunServer::frame(const QByteArray &payload)
+{
+    QByteArray framed(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(quint32(payload.size()), reinterpret_cast<uchar *>(framed.data()));
+    return framed + payload;
+}
+
+bool RunServer::takeFrame(QByteArray *buffer, QByteArray *payload)
+{
+    if (buffer->size() < 4)
+        return false;
+    const quint32 length = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer->constData()));
+    if (quint32(buffer->size() - 4) < length)
+        return false;
+    *payload = buffer->mid(4, int(length));
+    buffer->remove(0, 4 + int(length));
+    return true;
+}
+
+void RunServer::acceptConnection()
+{
+    // One editor per server; later connections are refused.
+    QLocalSocket *socket = server->nextPendingConnection();
+    if (client) {
+        socket->deleteLater();
+        return;
+    }
+    client = socket;
+    connect(client, SIGNAL(readyRead()), this, SLOT(readRequests()));
+    connect(client, SIGNAL(disconnected()), this, SLOT(clientDisconnected()));
+}
+
+void RunServer::clientDisconnected()
+{
+    // The editor is gone; so is everything it started.
+    if (child > 0)
+        killChild();
+    QCoreApplication::quit();
+}
+
+void RunServer::readRequests()
+{
+    incoming += client->readAll();
+    QByteArray payload;
+    while (takeFrame(&incoming, &payload)) {
+        QDataStream in(payload);
+        quint8 type;
+        in >> type;
+        switch (type) {
+        case RunMessage: {
+            QString interpreter;
+            QString fileName;
+            QByteArray source;
+            QStringList arguments;
+            in >> interpreter >> fileName >> source >> arguments;
+            run(interpreter, fileName, source, arguments);
+            break;
+        }
+        case CancelMessage:
+            cancel();
+            break;
+        case InputMessage: {
+            QByteArray data;
+            in >> data;
+            writeInput(data);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void RunServer::send(const QByteArray &payload)
+{
+    if (client)
+        client->write(frame(payload));
+}
+
+void RunServer::sendFailed(const QString &message)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(FailedMessage) << message;
+    send(payload);
+}
+
+void RunServer::run(const QString &interpreter, const QString &fileName, const QByteArray &source,
+                    const QStringList &arguments)
+{
+    if (child > 0) {
+        sendFailed(tr("A program is already running"));
+        return;
+    }
+
+    // The buffer is run as sent, saved or not.
+    const QString path = workDir.filePath("program.cmm");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(source) != source.size()) {
+        sendFailed(file.errorString());
+        return;
+    }
+    file.close();
+
+    // Everything the child needs is prepared before fork(); afterwards it
+    // may only make async-signal-safe calls.
+    QVector<QByteArray> argumentData;
+    argumentData << QFile::encodeName(interpreter) << QFile::encodeName(path);
+    for (const QString &argument : arguments)
+        argumentData << argument.toLocal8Bit();
+    QVector<char *> argv;
+    for (QByteArray &argument : argumentData)
+        argv << argument.data();
+    argv << 0;
+    const QByteArray directory = QFile::encodeName(fileName.isEmpty()
+            ? workDir.path() : QFileInfo(fileName).absolutePath());
+
+    int in[2], out[2], err[2];
+    if (!makePipe(in)) {
+        sendFailed(QString::fromLocal8Bit(std::strerror(errno)));
+        return;
+    }
+    if (!makePipe(out)) {
+        sendFailed(QString::fromLocal8Bit(std::strerror(errno)));
+        ::close(in[0]);
+        ::close(in[1]);
+        return;
+    }
+    if (!makePipe(err)) {
+        sendFailed(QString::fromLocal8Bit(std::strerror(errno)));
+        ::close(in[0]);
+        ::close(in[1]);
+        ::close(out[0]);
+        ::close(out[1]);
+        return;
+    }
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // Own process group, so cancelling also stops anything it spawns.
+        setpgid(0, 0);
+        // Ignored signals survive exec; the program gets the usual default.
+        ::signal(SIGPIPE, SIG_DFL);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        setLimit(RLIMIT_CPU, CpuSeconds);
+        setLimit(RLIMIT_AS, AddressSpace);
+        setLimit(RLIMIT_FSIZE, FileSize);
+        setLimit(RLIMIT_CORE, 0);
+        if (chdir(directory.constData()) != 0) {
+            // Relative paths then resolve against the server's directory.
+        }
+        execvp(argv[0], argv.data());
+        static const char message[] = "cannot execute the interpreter\n";
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+            // Nothing left to report to.
+        }
+        _exit(127);
+    }
+
+    // Also from this side, so the group exists before the child first runs
+    // and an early cancel does not miss it.
+    if (pid > 0)
+        setpgid(pid, pid);
+    ::close(in[0]);
+    ::close(out[1]);
+    ::close(err[1]);
+    if (pid < 0) {
+        sendFailed(QString::fromLocal8Bit(std::strerror(errno)));
+        ::close(in[1]);
+        ::close(out[0]);
+        ::close(err[0]);
+        return;
+    }
+
+    child = pid;
+    stdinFd = in[1];
+    stdoutFd = out[0];
+    stderrFd = err[0];
+    fcntl(stdinFd, F_SETFL, fcntl(stdinFd, F_GETFL) | O_NONBLOCK);
+    fcntl(stdoutFd, F_SETFL, fcntl(stdoutFd, F_GETFL) | O_NONBLOCK);
+    fcntl(stderrFd, F_SETFL, fcntl(stderrFd, F_GETFL) | O_NONBLOCK);
+    stdinNotifier = new QSocketNotifier(stdinFd, QSocketNotifier::Write, this);
+    stdinNotifier->setEnabled(false);
+    connect(stdinNotifier, SIGNAL(activated(int)), this, SLOT(writePendingInput()));
+    stdoutNotifier = new QSocketNotifier(stdoutFd, QSocketNotifier::Read, this);
+    stderrNotifier = new QSocketNotifier(stderrFd, QSocketNotifier::Read, this);
+    connect(stdoutNotifier, SIGNAL(activated(int)), this, SLOT(readChildOutput(int)));
+    connect(stderrNotifier, SIGNAL(activated(int)), this, SLOT(readChildOutput(int)));
+
+    cancelled = false;
+    clock.start();
+    reapTimer->start();
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << quint8(StartedMessage);
+    send(payload);
+}
+
+void RunServer::cancel()
+{
+    if (child <= 0)
+        return;
+    cancelled = true;
+    ::kill(-pid_t(child), SIGTERM);
+    killTimer->start();
+}
+
+void RunServer::killChild()
+{
+    if (child > 0)
+        ::kill(-pid_t(child), SIGKILL);
+}
+
+void RunServer::writeInput(const QByteArray &data)
+{
+    if (stdinFd < 0)
+        return;
+    // A child that does not read its input must not stall the server, so
+    // whatever the pipe cannot take now waits for the write notifier.
+    pendingInput += data;
+    writePendingInput();
+}
+
+void RunServer::writePendingInput()
+{
+    while (!pendingInput.isEmpty()) {
+        const ssize_t written = ::write(stdinFd, pendingInput.constData(), size_t(pendingInput.size()));
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                pendingInput.clear();
+            break;
+        }
+        pendingInput.remove(0, int(written));
+    }
+    stdinNotifier->setEnabled(!pendingInput.isEmpty());
+}
+
+void RunServer::readChildOutput(int fd)
+{
+    char buffer[64 * 1024];
+    const ssize_t count = ::read(fd, buffer, sizeof(buffer));
+    if (count > 0) {
+        QByteArray payload;
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out << quint8(OutputMessage) << (fd == stderrFd) << QByteArray(buffer, int(count));
+        send(payload);
+    } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+        // End of file; stop watching until the child is reaped.
+        if (fd == stdoutFd && stdoutNotifier)
+            stdoutNotifier->setEnabled(false);
+        if (fd == stderrFd && stderrNotifier)
+            stderrNotifier->setEnabled(false);
+    }
+}
+
+void RunServer::drainChildOutput()
+{
+    // What the child wrote just before exiting; anything it left running
+    // may keep the pipes open, so this stops at the first empty read.
+    const int fds[] = { stdoutFd, stderrFd };
+    for (int fd : fds) {
+        char buffer[64 * 1024];
+        ssize_t count;
+        while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            QByteArray payload;
+            QDataStream out(&payload, QIODevice::WriteOnly);
+            out << quint8(OutputMessage) << (fd == stderrFd) << QByteArray(buffer, int(count));
+            send(payload);
+        }
+    }
+}
+
+void RunServer::reapChild()
+{
+    int status = 0;
+    struct rusage usage;
+    const pid_t pid = wait4(pid_t(child), &status, WNOHANG, &usage);
+    if (pid == 0 || (pid < 0 && errno == EINTR))
+        return;
+
+    reapTimer->stop();
+    killTimer->stop();
+    drainChildOutput();
+    closeChildPipes();
+    child = -1;
+
+    // wait4 reports the usage of this child alone, unlike RUSAGE_CHILDREN.
+    const bool exited = pid > 0 && WIFEXITED(status);
+#ifdef Q_OS_MAC
+    const qint64 peakRssKb = pid > 0 ? qint64(usage.ru_maxrss) / 1024 : -1;
+#else
+    const qint64 peakRssKb = pid > 0 ? qint64(usage.ru_maxrss) : -1;
+#endif
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << quint8(FinishedMessage) << qint32(exited ? WEXITSTATUS(status) : -1)
+        << (!exited && !cancelled) << cancelled << qint64(clock.elapsed()) << peakRssKb;
+    send(payload);
+}
+
+void RunServer::closeChildPipes()
+{
+    delete stdinNotifier;
+    delete stdoutNotifier;
+    delete stderrNotifier;
+    stdinNotifier = 0;
+    stdoutNotifier = 0;
+    stderrNotifier = 0;
+    pendingInput.clear();
+    const int fds[] = { stdinFd, stdoutFd, stderrFd };
+    for (int fd : fds) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+    stdinFd = stdoutFd = stderrFd = -1;
+}
@@ -0,0 +1,108 @@
+/**
+* @file  runserver.h
+* @brief Header implementing the persistent interpreter run server.
+*
+*
+* @section License
+*
+* Copyright (C) 2013 Robert B. Colton
+* This file is a part of the QCodeEdit styled text control.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program. If not, see <http://www.gnu.org/licenses/>.
+**/
+
+#ifndef RUNSERVER_H
+#define RUNSERVER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <QTemporaryDir>
+
+QT_BEGIN_NAMESPACE
+class QLocalServer;
+class QLocalSocket;
+class QSocketNotifier;
+class QTimer;
+QT_END_NAMESPACE
+
+// Started once as "--run-server <name>" and kept running next to the
+// editor. It takes program buffers over a local socket and runs each one
+// in a child forked from this small, already initialized process, with
+// resource limits applied before the interpreter is executed. Output and
+// the exit status go back over the same socket. Unix only.
+class RunServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum MessageType {
+        RunMessage,         // client: interpreter, file name, source, arguments
+        CancelMessage,      // client
+        InputMessage,       // client: bytes for stdin
+        StartedMessage,     // server
+        OutputMessage,      // server: is stderr, bytes
+        FinishedMessage,    // server: exit code, crashed, cancelled, wall ms, peak RSS kB
+        FailedMessage       // server: message
+    };
+
+    RunServer(QObject *parent = 0);
+    ~RunServer();
+
+    bool listen(const QString &name);
+
+    // Messages are length-prefixed QDataStream payloads.
+    static QByteArray frame(const QByteArray &payload);
+    static bool takeFrame(QByteArray *buffer, QByteArray *payload);
+
+private slots:
+    void acceptConnection();
+    void readRequests();
+    void clientDisconnected();
+    void readChildOutput(int fd);
+    void writePendingInput();
+    void reapChild();
+    void killChild();
+
+private:
+    void run(const QString &interpreter, const QString &fileName, const QByteArray &source,
+             const QStringList &arguments);
+    void cancel();
+    void writeInput(const QByteArray &data);
+    void send(const QByteArray &payload);
+    void sendFailed(const QString &message);
+    void drainChildOutput();
+    void closeChildPipes();
+
+    QLocalServer *server;
+    QLocalSocket *client;
+    QByteArray incoming;
+    QTemporaryDir workDir;
+
+    qint64 child;
+    int stdinFd;
+    int stdoutFd;
+    int stderrFd;
+    QSocketNotifier *stdinNotifier;
+    QSocketNotifier *stdoutNotifier;
+    QSocketNotifier *stderrNotifier;
+    QByteArray pendingInput;    // what the child's stdin pipe had no room for yet
+    QTimer *reapTimer;
+    QTimer *killTimer;
+    QElapsedTimer clock;
+    bool cancelled;
+};
+
+#endif // RUNSERVER_H
@@ -0,0 +1,76 @@
+# Everything except main(); shared by the editor and the benchmarks.
+
+QT += widgets concurrent
+
+INCLUDEPATH += $$PWD $$PWD/CMM/include
+
+HEADERS += \
+                  $$PWD/mainwindow.h \
+                  $$PWD/fileloader.h \
+                  $$PWD/filesaver.h \
+                  $$PWD/cmmcheck.h \
+                  $$PWD/livechecker.h \
+                  $$PWD/diagnosticscache.h \
+                  $$PWD/projectchecker.h \
+                  $$PWD/batchcheck.h \
+                  $$PWD/incrementalcheck.h \
+                  $$PWD/diagnosticsmodel.h \
+                  $$PWD/findbar.h \
+                  $$PWD/programrunner.h \
+                  $$PWD/outputconsole.h \
+    $$PWD/QCodeEdit/qcodecpp.h \
+    $$PWD/QCodeEdit/qcodeedit.h \
+    $$PWD/QCodeEdit/qcodelexer.h \
+    $$PWD/QCodeEdit/qcodecompletion.h \
+    $$PWD/QCodeEdit/qcodesymbolindex.h \
+    $$PWD/QCodeEdit/qcodefind.h \
+    $$PWD/QCodeEdit/qcodeundo.h \
+    $$PWD/QCodeEdit/qcodeprofiler.h \
+    $$PWD/AST.h \
+    $$PWD/SourceMgr.h \
+    $$PWD/CMMParser.h \
+    $$PWD/CMMLexer.h
+
+SOURCES += \
+                  $$PWD/mainwindow.cpp \
+                  $$PWD/fileloader.cpp \
+                  $$PWD/filesaver.cpp \
+                  $$PWD/cmmcheck.cpp \
+                  $$PWD/livechecker.cpp \
+                  $$PWD/diagnosticscache.cpp \
+                  $$PWD/projectchecker.cpp \
+                  $$PWD/batchcheck.cpp \
+                  $$PWD/incrementalcheck.cpp \
+                  $$PWD/diagnosticsmodel.cpp \
+                  $$PWD/findbar.cpp \
+                  $$PWD/programrunner.cpp \
+                  $$PWD/outputconsole.cpp \
+    $$PWD/QCodeEdit/qcodecpp.cpp \
+    $$PWD/QCodeEdit/qcodeedit.cpp \
+    $$PWD/QCodeEdit/qcodelexer.cpp \
+    $$PWD/QCodeEdit/qcodecompletion.cpp \
+    $$PWD/QCodeEdit/qcodesymbolindex.cpp \
+    $$PWD/QCodeEdit/qcodefind.cpp \
+    $$PWD/QCodeEdit/qcodeundo.cpp \
+    $$PWD/CMM/src/AST.cpp \
+    $$PWD/CMM/src/SourceMgr.cpp \
+    $$PWD/CMM/src/CMMParser.cpp \
+    $$PWD/CMM/src/CMMLexer.cpp
+
+# The warm interpreter server forks and sets resource limits.
+unix {
+    HEADERS += $$PWD/runserver.h $$PWD/runclient.h
+    SOURCES += $$PWD/runserver.cpp $$PWD/runclient.cpp
+}
+
+# Timing probes around the hot paths; without this they compile to nothing.
+profiling {
+    DEFINES += QCODEEDIT_PROFILING
+    SOURCES += $$PWD/QCodeEdit/qcodeprofiler.cpp
+}
+
+RESOURCES += \
+    $$PWD/resources.qrc
+
+QMAKE_LFLAGS += -stdlib=libc++
+QMAKE_CXXFLAGS += -stdlib=libc++